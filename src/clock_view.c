@@ -0,0 +1,48 @@
+#include "clock_view.h"
+
+// Timers land this far past the boundary so the whole-second checks see the new value
+#define UPDATE_LANDING 5
+
+void clock_view_init(ClockView* view) {
+  for(uint8_t i = 0; i < CLOCK_FIELDS; i++) {
+    duration_init(&view->text[i]);
+  }
+}
+
+static bool render(ClockView* view, ClockField field, int32_t seconds, DurationFormat format) {
+  return duration_render(&view->text[field], seconds, format);
+}
+
+uint8_t clock_view_render(ClockView* view, int64_t now) {
+  int32_t drive = clock_elapsed(&duty->drive, now) / 1000;
+  int32_t rest = clock_elapsed(&duty->rest, now) / 1000;
+  int32_t drive_remaining = duty_rules->drive_limit - drive;
+  int32_t rest_remaining = duty_rules->break_total - rest;
+  DurationFormat drive_format = duty->battery_setting ? DURATION_H_MM : DURATION_H_MM_SS;
+  DurationFormat rest_format = duty->battery_setting ? DURATION_MM : DURATION_MM_SS;
+
+  uint8_t changed = 0;
+  changed |= render(view, CLOCK_DRIVE_TIME, drive, drive_format) << CLOCK_DRIVE_TIME;
+  changed |= render(view, CLOCK_DRIVE_REMAINING, drive_remaining > 0 ? drive_remaining : 0,
+                    drive_format) << CLOCK_DRIVE_REMAINING;
+  changed |= render(view, CLOCK_REST_TIME, rest, rest_format) << CLOCK_REST_TIME;
+  changed |= render(view, CLOCK_REST_REMAINING, rest_remaining > 0 ? rest_remaining : 0,
+                    rest_format) << CLOCK_REST_REMAINING;
+  return changed;
+}
+
+static bool running() {
+  return duty->drive.running || duty->rest.running;
+}
+
+bool clock_view_minute_ticks() {
+  return duty->battery_setting && running();
+}
+
+int32_t clock_view_next_update() {
+  if(!running()) {
+    return -1;
+  }
+  int32_t wait = duty_next_change(duty->battery_setting ? 0 : 1000);
+  return wait < 0 ? -1 : wait + UPDATE_LANDING;
+}
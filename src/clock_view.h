@@ -0,0 +1,35 @@
+#pragma once
+
+#include "duty/duty.h"
+#include "duration.h"
+
+// What the two clocks show and when they next need looking at, kept apart from the window so
+// the host tests replay the same code the watch runs. The caller owns the timer, the minute
+// tick and the dashboard.
+typedef enum {
+  CLOCK_DRIVE_TIME = 0,
+  CLOCK_DRIVE_REMAINING,
+  CLOCK_REST_TIME,
+  CLOCK_REST_REMAINING,
+  CLOCK_FIELDS,
+} ClockField;
+
+typedef struct {
+  DurationText text[CLOCK_FIELDS];
+} ClockView;
+
+// Forget what was shown, so the next render lays every field out afresh
+void clock_view_init(ClockView* view);
+
+// Bring each field up to the clocks at now: time and remaining time to the limit, to the
+// second or, in battery saving mode, to the minute. Returns a bit per ClockField whose text
+// changed.
+uint8_t clock_view_render(ClockView* view, int64_t now);
+
+// Whether the display follows the system minute tick, as it does in battery saving mode while
+// a clock runs
+bool clock_view_minute_ticks();
+
+// Milliseconds until the update timer should fire, for the next second or deadline or, on
+// minute ticks, only the next deadline; -1 if nothing is running
+int32_t clock_view_next_update();
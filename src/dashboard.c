@@ -0,0 +1,178 @@
+#include <pebble.h>
+#include "dashboard.h"
+#include "glyph_atlas.h"
+#include "duty/perf.h"
+
+#define LABEL_WIDTH 72
+#define LABEL_COUNT 4
+
+typedef struct {
+  GRect rect;
+  const char* text;
+} Label;
+
+static const Label labels[LABEL_COUNT] = {
+  { {{4, 2}, {LABEL_WIDTH, 12}}, "Drive time" },
+  { {{4, 43}, {LABEL_WIDTH, 15}}, "Remaining" },
+  { {{4, 75}, {LABEL_WIDTH, 12}}, "Rest time" },
+  { {{4, 115}, {LABEL_WIDTH, 15}}, "Remaining" },
+};
+
+// 1-bit copies of the labels, one bit per pixel row by row, taken from the first frame
+#define LABEL_BITS (LABEL_WIDTH * (12 + 15 + 12 + 15))
+static uint8_t label_pixels[(LABEL_BITS + 7) / 8];
+
+static const GRect field_rects[DASH_FIELDS] = {
+  [DASH_DRIVE_TIME] = {{4, 8}, {124, 34}},
+  [DASH_DRIVE_REMAINING] = {{4, 53}, {124, 22}},
+  [DASH_REST_TIME] = {{4, 81}, {124, 34}},
+  [DASH_REST_REMAINING] = {{4, 125}, {124, 22}},
+  [DASH_DAY_LIMIT] = {{60, -2}, {60, 16}},
+  [DASH_BREAK_DUE] = {{60, 41}, {60, 16}},
+  [DASH_REST_COMPLETE] = {{60, 113}, {60, 16}},
+  [DASH_PROFILE] = {{60, 73}, {60, 16}},
+  [DASH_ACTIVITY] = {{60, -2}, {60, 16}},
+};
+
+// Projections, the profile and the activity are right aligned against the action bar, clear
+// of the labels
+#define FIRST_PROJECTION DASH_DAY_LIMIT
+
+// The clocks come from the glyph atlas, in these sizes
+static const AtlasSize value_sizes[FIRST_PROJECTION] = {
+  [DASH_DRIVE_TIME] = ATLAS_LARGE,
+  [DASH_DRIVE_REMAINING] = ATLAS_SMALL,
+  [DASH_REST_TIME] = ATLAS_LARGE,
+  [DASH_REST_REMAINING] = ATLAS_SMALL,
+};
+
+// Everything the update proc draws
+typedef struct {
+  char text[DASH_FIELDS][12];
+} DashboardModel;
+
+static DashboardModel model;
+static Layer* layer;
+static GFont fonts[DASH_FIELDS];
+// Without the atlas the clocks fall back to system fonts, which cost no heap
+static bool atlas_loaded;
+// Only held until the labels have been captured
+static GFont label_font;
+
+static bool pixel_get(const uint8_t* bits, uint16_t index) {
+  return bits[index >> 3] & (1 << (index & 7));
+}
+
+static void pixel_set(uint8_t* bits, uint16_t index) {
+  bits[index >> 3] |= 1 << (index & 7);
+}
+
+// Walk every label pixel alongside its place in the frame buffer, either copying the frame
+// buffer into label_pixels or drawing label_pixels back into it. Returns false if the frame
+// buffer is unavailable.
+static bool transfer_labels(GContext* ctx, bool capture) {
+  GBitmap* frame = graphics_capture_frame_buffer(ctx);
+  if(frame == NULL) {
+    return false;
+  }
+  uint8_t* data = gbitmap_get_data(frame);
+  uint16_t stride = gbitmap_get_bytes_per_row(frame);
+  // Whatever of the screen the layer does not cover is the status bar above it
+  int16_t screen_top = gbitmap_get_bounds(frame).size.h - layer_get_bounds(layer).size.h;
+  uint16_t index = 0;
+  for(uint8_t i = 0; i < LABEL_COUNT; i++) {
+    const GRect* rect = &labels[i].rect;
+    for(int16_t y = 0; y < rect->size.h; y++) {
+      uint8_t* row = data + (screen_top + rect->origin.y + y) * stride;
+      for(int16_t x = 0; x < rect->size.w; x++, index++) {
+        uint16_t column = rect->origin.x + x;
+        if(capture && pixel_get(row, column)) {
+          pixel_set(label_pixels, index);
+        } else if(!capture && pixel_get(label_pixels, index)) {
+          pixel_set(row, column);
+        }
+      }
+    }
+  }
+  graphics_release_frame_buffer(ctx, frame);
+  return true;
+}
+
+static void dashboard_update(Layer* canvas, GContext* ctx) {
+  graphics_context_set_text_color(ctx, GColorWhite);
+
+  // The labels never change, so they are drawn as text once and blitted from then on. Colour
+  // frame buffers are not 1-bit, so there the font stays and the labels are drawn each time.
+  if(label_font != NULL) {
+    for(uint8_t i = 0; i < LABEL_COUNT; i++) {
+      graphics_draw_text(ctx, labels[i].text, label_font, labels[i].rect,
+                         GTextOverflowModeWordWrap, GTextAlignmentLeft, NULL);
+    }
+#ifndef PBL_COLOR
+    if(transfer_labels(ctx, true)) {
+      fonts_unload_custom_font(label_font);
+      label_font = NULL;
+    }
+#endif
+  }
+
+  for(uint8_t i = 0; i < DASH_FIELDS; i++) {
+    if(i < FIRST_PROJECTION && atlas_loaded) {
+      glyph_atlas_draw(ctx, value_sizes[i], model.text[i], field_rects[i].origin);
+      continue;
+    }
+    graphics_draw_text(ctx, model.text[i], fonts[i], field_rects[i], GTextOverflowModeWordWrap,
+                       i >= FIRST_PROJECTION ? GTextAlignmentRight : GTextAlignmentLeft, NULL);
+  }
+
+  // Labels go on last, as they sit above the top of the large digits' line box
+  if(label_font == NULL) {
+    transfer_labels(ctx, false);
+  }
+  perf_count(PERF_REDRAW, 1);
+}
+
+Layer* dashboard_create(Layer* parent) {
+  GRect bounds = layer_get_bounds(parent);
+  memset(&model, 0, sizeof(model));
+  memset(label_pixels, 0, sizeof(label_pixels));
+  atlas_loaded = glyph_atlas_load(RESOURCE_ID_TIMER_DIGITS);
+  if(!atlas_loaded) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Glyph atlas not loaded, using system fonts.");
+  }
+  fonts[DASH_DRIVE_TIME] = fonts_get_system_font(FONT_KEY_BITHAM_34_MEDIUM_NUMBERS);
+  fonts[DASH_DRIVE_REMAINING] = fonts_get_system_font(FONT_KEY_GOTHIC_24);
+  fonts[DASH_REST_TIME] = fonts[DASH_DRIVE_TIME];
+  fonts[DASH_REST_REMAINING] = fonts[DASH_DRIVE_REMAINING];
+  for(uint8_t i = FIRST_PROJECTION; i < DASH_FIELDS; i++) {
+    fonts[i] = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  }
+  label_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_ROBOTO_LIGHT_12));
+
+  layer = layer_create(bounds);
+  layer_set_update_proc(layer, dashboard_update);
+  layer_add_child(parent, layer);
+  return layer;
+}
+
+void dashboard_destroy() {
+  if(label_font != NULL) {
+    fonts_unload_custom_font(label_font);
+    label_font = NULL;
+  }
+  if(atlas_loaded) {
+    glyph_atlas_unload();
+    atlas_loaded = false;
+  }
+  layer_destroy(layer);
+  layer = NULL;
+}
+
+void dashboard_set_text(DashField field, const char* text) {
+  if(strcmp(model.text[field], text) == 0) {
+    return;
+  }
+  strncpy(model.text[field], text, sizeof(model.text[field]) - 1);
+  // Pebble redraws a layer whole, so a change to any field costs one pass over all of them
+  layer_mark_dirty(layer);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <pebble.h>
+
+// The main display: one layer drawing both clocks from a small view model
+typedef enum {
+  DASH_DRIVE_TIME = 0,
+  DASH_DRIVE_REMAINING,
+  DASH_REST_TIME,
+  DASH_REST_REMAINING,
+  // Projected wall-clock times, on the label rows
+  DASH_DAY_LIMIT,
+  DASH_BREAK_DUE,
+  DASH_REST_COMPLETE,
+  // Which driver profile the clocks belong to
+  DASH_PROFILE,
+  // Other work or availability, in place of the day limit, which only shows while driving
+  DASH_ACTIVITY,
+  DASH_FIELDS,
+} DashField;
+
+// Create the dashboard over the whole of parent
+Layer* dashboard_create(Layer* parent);
+void dashboard_destroy();
+
+// Change what one field shows; the layer is only redrawn if the text differs
+void dashboard_set_text(DashField field, const char* text);
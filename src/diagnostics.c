@@ -0,0 +1,109 @@
+#include <pebble.h>
+#include "diagnostics.h"
+#include "duty/perf.h"
+
+// Refresh while open, so the view itself is the only extra cost and only while it is up
+#define DIAGNOSTICS_REFRESH 1000
+
+static Window* window = NULL;
+static TextLayer* text_layer;
+static AppTimer* refresh_timer = NULL;
+static char text[320];
+
+// Tenths of a count per minute of the given seconds
+static uint32_t per_minute_tenths(uint32_t count, uint32_t seconds) {
+  return seconds > 0 ? (uint32_t)((uint64_t)count * 600 / seconds) : 0;
+}
+
+static size_t print_mode(char* out, size_t size, const char* name, const PerfMode* mode) {
+  uint32_t wakeups = per_minute_tenths(mode->counters[PERF_WAKEUP], mode->seconds);
+  uint32_t redraws = per_minute_tenths(mode->counters[PERF_REDRAW], mode->seconds);
+  return snprintf(out, size, "%s %lu min\nwake %lu.%lu/min draw %lu.%lu/min\n%lu writes %lu B max %u ms\n",
+                  name, (unsigned long)(mode->seconds / 60),
+                  (unsigned long)(wakeups / 10), (unsigned long)(wakeups % 10),
+                  (unsigned long)(redraws / 10), (unsigned long)(redraws % 10),
+                  (unsigned long)mode->counters[PERF_PERSIST_WRITE],
+                  (unsigned long)mode->counters[PERF_PERSIST_BYTES],
+                  mode->handler_max_ms);
+}
+
+// snprintf returns what it would have written, so once the text is full the length stays at
+// the end of the buffer rather than running past it
+static size_t appended(size_t length, int written) {
+  if(written > 0) {
+    length += written;
+  }
+  return length < sizeof(text) ? length : sizeof(text);
+}
+
+static void refresh() {
+  PerfMode modes[PERF_MODES];
+  size_t length = 0;
+  perf_get(modes);
+  length = appended(length, print_mode(text + length, sizeof(text) - length, "Normal", &modes[0]));
+  if(length < sizeof(text)) {
+    length = appended(length, print_mode(text + length, sizeof(text) - length, "Battery", &modes[1]));
+  }
+
+  // The worker's figures are as of its last hourly save
+  if(perf_get_worker(modes) && length < sizeof(text)) {
+    uint32_t seconds = modes[0].seconds + modes[1].seconds;
+    uint32_t wakeups = per_minute_tenths(modes[0].counters[PERF_WAKEUP] + modes[1].counters[PERF_WAKEUP], seconds);
+    uint16_t worst = modes[0].handler_max_ms > modes[1].handler_max_ms ? modes[0].handler_max_ms : modes[1].handler_max_ms;
+    length = appended(length, snprintf(text + length, sizeof(text) - length, "Worker wake %lu.%lu/min max %u ms\n",
+                                       (unsigned long)(wakeups / 10), (unsigned long)(wakeups % 10), worst));
+  }
+  if(length < sizeof(text)) {
+    snprintf(text + length, sizeof(text) - length, "Heap %u used %u free",
+             (unsigned)heap_bytes_used(), (unsigned)heap_bytes_free());
+  }
+  text_layer_set_text(text_layer, text);
+}
+
+static void handle_refresh(void* data) {
+  refresh();
+  refresh_timer = app_timer_register(DIAGNOSTICS_REFRESH, handle_refresh, NULL);
+}
+
+// SELECT starts the counters again, e.g. before comparing a new firmware
+static void clear_handler(ClickRecognizerRef recognizer, void* context) {
+  perf_clear();
+  perf_save();
+  refresh();
+}
+
+static void click_config_provider(void* context) {
+  window_single_click_subscribe(BUTTON_ID_SELECT, clear_handler);
+}
+
+static void window_load(Window* window) {
+  Layer* root = window_get_root_layer(window);
+  text_layer = text_layer_create(layer_get_bounds(root));
+  text_layer_set_background_color(text_layer, GColorBlack);
+  text_layer_set_text_color(text_layer, GColorWhite);
+  text_layer_set_font(text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+  layer_add_child(root, text_layer_get_layer(text_layer));
+  handle_refresh(NULL);
+}
+
+static void window_unload(Window* dialog) {
+  app_timer_cancel(refresh_timer);
+  refresh_timer = NULL;
+  text_layer_destroy(text_layer);
+  window_destroy(dialog);
+  window = NULL;
+}
+
+void diagnostics_show() {
+  if(window != NULL) {
+    return;
+  }
+  window = window_create();
+  window_set_window_handlers(window, (WindowHandlers) {
+    .load = window_load,
+    .unload = window_unload,
+  });
+  window_set_click_config_provider(window, click_config_provider);
+  window_set_background_color(window, GColorBlack);
+  window_stack_push(window, true);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <pebble.h>
+
+// A hidden view of the perf counters and heap, built only while it is on screen
+void diagnostics_show();
@@ -0,0 +1,119 @@
+#include <string.h>
+#include "duration.h"
+
+static bool shows_seconds(DurationFormat format) {
+  return format == DURATION_H_MM_SS || format == DURATION_MM_SS;
+}
+
+// Seconds per step of the last digit shown
+static int32_t unit(DurationFormat format) {
+  return shows_seconds(format) ? 1 : 60;
+}
+
+static char* put_two(char* out, uint32_t value) {
+  *out++ = '0' + value / 10;
+  *out++ = '0' + value % 10;
+  return out;
+}
+
+// Lay the whole text out from scratch
+static void layout(DurationText* duration, int32_t seconds) {
+  char* out = duration->text;
+  uint32_t magnitude = seconds < 0 ? -(uint32_t)seconds : (uint32_t)seconds;
+  if(seconds < 0) {
+    *out++ = '-';
+  }
+  uint32_t hours = magnitude / 3600;
+  uint32_t minutes = magnitude / 60 % 60;
+  DurationFormat format = duration->format;
+
+  if(hours > 0 || format == DURATION_H_MM_SS || format == DURATION_H_MM) {
+    char digits[10];
+    uint8_t count = 0;
+    do {
+      digits[count++] = '0' + hours % 10;
+      hours /= 10;
+    } while(hours > 0);
+    while(count > 0) {
+      *out++ = digits[--count];
+    }
+    *out++ = ':';
+  }
+  out = put_two(out, minutes);
+  if(shows_seconds(format)) {
+    *out++ = ':';
+    out = put_two(out, magnitude % 60);
+  }
+  *out = '\0';
+  duration->length = out - duration->text;
+}
+
+// Step the text by one unit in place, carrying or borrowing through the digits that roll
+// over. Returns false where the layout would change (gaining or losing an hours digit) so
+// the caller lays out afresh instead.
+static bool step(DurationText* duration, bool up) {
+  // Radix of each digit from the right: seconds, ten-seconds, minutes, ten-minutes, then
+  // decimal hours
+  static const uint8_t radix[] = { 10, 6, 10, 6 };
+  uint8_t digit = shows_seconds(duration->format) ? 0 : 2;
+  for(int8_t i = duration->length - 1; i >= 0; i--) {
+    char* c = &duration->text[i];
+    if(*c == ':') {
+      continue;
+    }
+    uint8_t base = digit < sizeof(radix) ? radix[digit] : 10;
+    uint8_t value = *c - '0';
+    if(up && value + 1 < base) {
+      *c += 1;
+      return true;
+    }
+    if(!up && value > 0) {
+      *c -= 1;
+      // Borrowing the leading hour down to nothing changes the layout
+      return !(digit >= sizeof(radix) && i == 0 && *c == '0' && duration->length > 1 && duration->text[1] != ':');
+    }
+    *c = up ? '0' : '0' + base - 1;
+    digit++;
+  }
+  // Ran out of digits
+  return false;
+}
+
+void duration_init(DurationText* duration) {
+  duration->text[0] = '\0';
+  duration->length = 0;
+  duration->seconds = 0;
+  duration->format = DURATION_H_MM_SS;
+}
+
+bool duration_render(DurationText* duration, int32_t seconds, DurationFormat format) {
+  if(duration->length > 0 && format == duration->format) {
+    int32_t size = unit(format);
+    int32_t shown = duration->seconds / size;
+    int32_t wanted = seconds / size;
+    if(wanted == shown && (seconds < 0) == (duration->seconds < 0)) {
+      duration->seconds = seconds;
+      return false;
+    }
+    // The common case: a clock ticking on or counting down by one unit
+    if(duration->seconds >= 0 && seconds >= 0 && (wanted == shown + 1 || wanted == shown - 1)) {
+      bool up = wanted > shown;
+      // An hours field appears at an hour and goes below it in the minute-first formats
+      bool regrows = (format == DURATION_MM_SS || format == DURATION_MM)
+          && (seconds >= 3600) != (duration->seconds >= 3600);
+      // A failed step leaves the text half done, but it is laid out afresh below anyway
+      if(!regrows && step(duration, up)) {
+        duration->seconds = seconds;
+        return true;
+      }
+    }
+  }
+  // From an hour up the hour-first and minute-first formats read the same, so a change of
+  // format alone can leave the text as it was
+  char before[DURATION_TEXT_SIZE];
+  memcpy(before, duration->text, sizeof(before));
+  duration->format = format;
+  duration->seconds = seconds;
+  layout(duration, seconds);
+  return strcmp(before, duration->text) != 0;
+}
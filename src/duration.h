@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// How a duration in whole seconds is laid out. The minute-first formats grow an hours field
+// once the duration reaches an hour, rather than wrapping.
+typedef enum {
+  DURATION_H_MM_SS = 0,
+  DURATION_H_MM,
+  DURATION_MM_SS,
+  DURATION_MM,
+} DurationFormat;
+
+// Longest text: a sign, six hour digits for INT32_MAX seconds, :MM:SS and the terminator
+#define DURATION_TEXT_SIZE 16
+
+// A duration's text and the value it shows. Consecutive ticks only rewrite the digits that
+// roll over, odometer style; anything else lays the text out afresh.
+typedef struct {
+  char text[DURATION_TEXT_SIZE];
+  int32_t seconds;
+  DurationFormat format;
+  uint8_t length;
+} DurationText;
+
+// Reset so the next render lays the text out in full
+void duration_init(DurationText* duration);
+
+// Show seconds in format; false if the text is unchanged
+bool duration_render(DurationText* duration, int32_t seconds, DurationFormat format);
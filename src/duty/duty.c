@@ -0,0 +1,570 @@
+#include "sdk.h"
+#include "duty.h"
+#include "duty_log.h"
+#include "duty_totals.h"
+#include "perf.h"
+
+// Checkpoints follow state changes but never more often than this
+#define CHECKPOINT_MIN_INTERVAL 10000
+
+// Every profile's state stays in memory, so switching is only a change of pointer
+static DutyState profiles[DUTY_PROFILES];
+DutyState* duty = &profiles[0];
+uint8_t duty_profile = 0;
+uint8_t duty_motion_mode = MOTION_OFF;
+uint32_t duty_revision = 0;
+const RuleSet* duty_rules;
+DeadlineList duty_drive_deadlines;
+DeadlineList duty_rest_deadlines;
+
+// Checkpoints alternate between a profile's A and B keys by generation, so a torn write can
+// only ever damage the older of the two
+typedef struct {
+  uint32_t generation;
+  DutyState state;
+  uint16_t checksum;
+} __attribute__((__packed__)) Checkpoint;
+
+static uint32_t checkpoint_generation[DUTY_PROFILES];
+static DutyState checkpointed[DUTY_PROFILES];
+static int64_t last_checkpoint = 0;
+static AppTimer* checkpoint_timer = NULL;
+
+// Layout written under PERSIST_STATE_LEGACY by version 1.2, read once to migrate
+typedef struct {
+	bool started;
+	double elapsed_time;
+	double start_time;
+	double pause_time;
+  bool rest_started;
+	double rest_elapsed_time;
+	double rest_start_time;
+	double pause_rest_time;
+  bool battery_setting;
+  bool rules_setting;
+} __attribute__((__packed__)) LegacyState;
+
+int64_t epoch_ms() {
+	time_t seconds;
+	uint16_t milliseconds;
+	time_ms(&seconds, &milliseconds);
+	return (int64_t)seconds * 1000 + milliseconds;
+}
+
+// Pick the rule set for the current setting and precompute its deadlines, so the tick path
+// never evaluates rules
+static void apply_rules() {
+  duty_revision++;
+  duty_rules = rules_get(duty->rules_setting ? RULES_DOMESTIC : RULES_EU_HGV);
+  rules_drive_deadlines(duty_rules, &duty_drive_deadlines);
+  rules_rest_deadlines(duty_rules, &duty_rest_deadlines);
+}
+
+// Treat everything the clocks have already passed as handled, so a rule change or migrated
+// state does not replay old alerts
+static void settle_alarms() {
+  int64_t now = epoch_ms();
+  duty->drive_alarmed = clock_elapsed(&duty->drive, now) / 1000;
+  duty->rest_alarmed = clock_elapsed(&duty->rest, now) / 1000;
+}
+
+// Convert a clock saved as double seconds by version 1.2
+static DutyClock migrate_legacy_clock(bool legacy_started, double legacy_elapsed, double legacy_start) {
+  DutyClock clock = { .running = false, .banked = 0, .mark = 0 };
+  if(legacy_start == 0) {
+    return clock;
+  }
+  if(legacy_started) {
+    clock.running = true;
+    clock.mark = (int64_t)(legacy_start * 1000);
+  } else {
+    clock.banked = (int32_t)(legacy_elapsed * 1000);
+  }
+  return clock;
+}
+
+// Fletcher-16 over the first length bytes of a checkpoint, which stop short of its checksum
+static uint16_t checkpoint_checksum(const void* checkpoint, size_t length) {
+  const uint8_t* data = (const uint8_t*)checkpoint;
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for(size_t i = 0; i < length; i++) {
+    sum1 = (sum1 + data[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+static bool read_checkpoint(uint32_t key, Checkpoint* checkpoint) {
+  return persist_read_data(key, checkpoint, sizeof(*checkpoint)) == sizeof(*checkpoint)
+      && checkpoint_checksum(checkpoint, offsetof(Checkpoint, checksum)) == checkpoint->checksum
+      && checkpoint->state.activity < DUTY_ACTIVITIES;
+}
+
+// The first profile keeps the keys used before there were profiles
+static uint32_t checkpoint_key(uint8_t profile, uint32_t generation) {
+  uint8_t slot = (generation & 1) ? 0 : 1;
+  return profile == 0 ? PERSIST_STATE_A + slot : PERSIST_PROFILE_STATES + (profile - 1) * 2 + slot;
+}
+
+static bool profile_changed(uint8_t profile) {
+  return checkpoint_generation[profile] == 0
+      || memcmp(&profiles[profile], &checkpointed[profile], sizeof(DutyState)) != 0;
+}
+
+// Write the next generation into the older slot, unless nothing changed since the last one.
+// True if a checkpoint was written.
+static bool save_profile(uint8_t profile) {
+  if(!profile_changed(profile)) {
+    return false;
+  }
+
+  const DutyState* state = &profiles[profile];
+  Checkpoint checkpoint = {
+    .generation = checkpoint_generation[profile] + 1,
+    .state = *state,
+  };
+  checkpoint.checksum = checkpoint_checksum(&checkpoint, offsetof(Checkpoint, checksum));
+	status_t status = persist_write_data(checkpoint_key(profile, checkpoint.generation), &checkpoint, sizeof(checkpoint));
+  perf_persist_written(status, sizeof(checkpoint));
+	if(status < S_SUCCESS) {
+		APP_LOG(APP_LOG_LEVEL_WARNING, "Failed to persist state: %ld", status);
+    return false;
+	}
+  checkpoint_generation[profile] = checkpoint.generation;
+  checkpointed[profile] = *state;
+  return true;
+}
+
+// Only profiles that changed are written, and only a real write starts the minimum interval
+void duty_save() {
+  if(checkpoint_timer != NULL) {
+    app_timer_cancel(checkpoint_timer);
+    checkpoint_timer = NULL;
+  }
+  bool written = false;
+  for(uint8_t i = 0; i < DUTY_PROFILES; i++) {
+    written |= save_profile(i);
+  }
+  if(written) {
+    last_checkpoint = epoch_ms();
+  }
+}
+
+static void handle_checkpoint_timer(void* data) {
+  checkpoint_timer = NULL;
+  duty_save();
+}
+
+// Called on every refresh, so an unchanged state must not so much as arm a timer
+void duty_checkpoint() {
+  if(checkpoint_timer != NULL) {
+    return;
+  }
+  bool changed = false;
+  for(uint8_t i = 0; i < DUTY_PROFILES && !changed; i++) {
+    changed = profile_changed(i);
+  }
+  if(!changed) {
+    return;
+  }
+  int64_t since = epoch_ms() - last_checkpoint;
+  if(since >= CHECKPOINT_MIN_INTERVAL || since < 0) {
+    duty_save();
+  } else {
+    checkpoint_timer = app_timer_register(CHECKPOINT_MIN_INTERVAL - since, handle_checkpoint_timer, NULL);
+  }
+}
+
+static bool load_profile(uint8_t profile) {
+  Checkpoint a;
+  Checkpoint b;
+  bool a_valid = read_checkpoint(checkpoint_key(profile, 1), &a);
+  bool b_valid = read_checkpoint(checkpoint_key(profile, 2), &b);
+  if(!a_valid && !b_valid) {
+    checkpoint_generation[profile] = 0;
+    return false;
+  }
+  Checkpoint* latest = &a;
+  if(!a_valid || (b_valid && (int32_t)(b.generation - a.generation) > 0)) {
+    latest = &b;
+  }
+  profiles[profile] = latest->state;
+  checkpoint_generation[profile] = latest->generation;
+  checkpointed[profile] = latest->state;
+  return true;
+}
+
+// Point duty at a profile, with its totals and the rule set it runs under
+static void select_profile(uint8_t profile) {
+  duty_profile = profile;
+  duty = &profiles[profile];
+  duty_totals_init(profile);
+  apply_rules();
+}
+
+bool duty_load() {
+  bool loaded = false;
+  memset(profiles, 0, sizeof(profiles));
+  for(uint8_t i = 0; i < DUTY_PROFILES; i++) {
+    loaded |= load_profile(i);
+  }
+  // Profiles that were never used start out with the same settings as the first
+  for(uint8_t i = 1; i < DUTY_PROFILES; i++) {
+    if(checkpoint_generation[i] == 0) {
+      profiles[i].battery_setting = profiles[0].battery_setting;
+      profiles[i].rules_setting = profiles[0].rules_setting;
+    }
+  }
+  duty_motion_mode = persist_exists(PERSIST_MOTION) ? persist_read_int(PERSIST_MOTION) : MOTION_OFF;
+  if(duty_motion_mode >= MOTION_MODES) {
+    duty_motion_mode = MOTION_OFF;
+  }
+  uint8_t profile = persist_exists(PERSIST_PROFILE) ? persist_read_int(PERSIST_PROFILE) : 0;
+  // Whoever owns the state may have added to the totals as well, so they are always reread
+  select_profile(profile < DUTY_PROFILES ? profile : 0);
+  return loaded;
+}
+
+// Load state the way duty_load does, falling back to a one-off migration from version 1.2
+static bool load_or_migrate() {
+  if(duty_load()) {
+    return true;
+  }
+
+  LegacyState legacy;
+  if(persist_read_data(PERSIST_STATE_LEGACY, &legacy, sizeof(legacy)) == sizeof(legacy)) {
+    duty->drive = migrate_legacy_clock(legacy.started, legacy.elapsed_time, legacy.start_time);
+    duty->rest = migrate_legacy_clock(legacy.rest_started, legacy.rest_elapsed_time, legacy.rest_start_time);
+    if(duty->drive.running) {
+      duty->activity = DUTY_DRIVE;
+      duty->activity_mark = duty->drive.mark;
+    } else if(duty->rest.running) {
+      duty->activity = DUTY_REST;
+      duty->activity_mark = duty->rest.mark;
+    }
+    settle_alarms();
+    duty->battery_setting = legacy.battery_setting;
+    duty->rules_setting = legacy.rules_setting;
+    apply_rules();
+    // Only drop the old key once the converted state is safely down
+    duty_save();
+    if(checkpoint_generation[0] > 0) {
+      persist_delete(PERSIST_STATE_LEGACY);
+    }
+    APP_LOG(APP_LOG_LEVEL_INFO, "Migrated legacy persisted state.");
+    return true;
+  }
+  return false;
+}
+
+bool duty_init() {
+  duty_log_init();
+  // Totals are read along with the state
+  return load_or_migrate();
+}
+
+void duty_deinit() {
+  duty_save();
+  duty_log_deinit();
+}
+
+// A button's effect on the break, besides the change of activity
+#define SETTLE_BREAK (1 << 0)
+
+typedef struct {
+  uint8_t to;
+  uint8_t effects;
+} Transition;
+
+// Where each button leads from each activity. Going to work of either kind settles the
+// break in hand: a completed one resets the clocks, an unfinished one keeps only its credit.
+static const Transition transitions[DUTY_ACTIVITIES][DUTY_PRESSES] = {
+  [DUTY_OFF] = {
+    [DUTY_PRESS_DRIVE] = { DUTY_DRIVE, SETTLE_BREAK },
+    [DUTY_PRESS_REST] = { DUTY_REST, 0 },
+    [DUTY_PRESS_WORK] = { DUTY_OTHER_WORK, SETTLE_BREAK },
+  },
+  [DUTY_DRIVE] = {
+    [DUTY_PRESS_DRIVE] = { DUTY_OFF, SETTLE_BREAK },
+    [DUTY_PRESS_REST] = { DUTY_REST, 0 },
+    [DUTY_PRESS_WORK] = { DUTY_OTHER_WORK, SETTLE_BREAK },
+  },
+  [DUTY_REST] = {
+    [DUTY_PRESS_DRIVE] = { DUTY_DRIVE, SETTLE_BREAK },
+    [DUTY_PRESS_REST] = { DUTY_OFF, 0 },
+    [DUTY_PRESS_WORK] = { DUTY_OTHER_WORK, SETTLE_BREAK },
+  },
+  [DUTY_OTHER_WORK] = {
+    [DUTY_PRESS_DRIVE] = { DUTY_DRIVE, SETTLE_BREAK },
+    [DUTY_PRESS_REST] = { DUTY_REST, 0 },
+    [DUTY_PRESS_WORK] = { DUTY_AVAILABLE, 0 },
+  },
+  [DUTY_AVAILABLE] = {
+    [DUTY_PRESS_DRIVE] = { DUTY_DRIVE, SETTLE_BREAK },
+    [DUTY_PRESS_REST] = { DUTY_REST, 0 },
+    [DUTY_PRESS_WORK] = { DUTY_OFF, 0 },
+  },
+};
+
+typedef struct {
+  DutyEvent start;
+  DutyEvent stop;
+  DutyTotal total;
+  // Whether starting it is checked against the driving and working-time limits
+  bool work;
+} ActivityInfo;
+
+// How each activity apart from DUTY_OFF is logged and totalled
+static const ActivityInfo activities[DUTY_ACTIVITIES] = {
+  [DUTY_DRIVE] = { DUTY_EVENT_DRIVE_START, DUTY_EVENT_DRIVE_STOP, DUTY_TOTAL_DRIVE, true },
+  [DUTY_REST] = { DUTY_EVENT_REST_START, DUTY_EVENT_REST_STOP, DUTY_TOTAL_REST, false },
+  [DUTY_OTHER_WORK] = { DUTY_EVENT_WORK_START, DUTY_EVENT_WORK_STOP, DUTY_TOTAL_WORK, true },
+  [DUTY_AVAILABLE] = { DUTY_EVENT_AVAILABLE_START, DUTY_EVENT_AVAILABLE_STOP, DUTY_TOTAL_AVAILABLE, false },
+};
+
+// The clock an activity runs, if it has one
+static DutyClock* activity_clock(uint8_t activity) {
+  switch(activity) {
+    case DUTY_DRIVE:
+      return &duty->drive;
+    case DUTY_REST:
+      return &duty->rest;
+    default:
+      return NULL;
+  }
+}
+
+// Whether the day, week or fortnight allowance is already used up, for driving or for any
+// work at all
+static bool over_duty_limits(bool driving) {
+  DutyTotals totals;
+  duty_totals_get(time(NULL), duty_rules->day_drive_limit, &totals);
+  if((duty_rules->day_work_limit > 0 && totals.day_work >= duty_rules->day_work_limit)
+      || (duty_rules->week_work_limit > 0 && totals.week_work >= duty_rules->week_work_limit)) {
+    return true;
+  }
+  if(!driving) {
+    return false;
+  }
+  int32_t day_limit = rules_day_drive_limit(duty_rules, totals.week_extended_days);
+  return totals.day_drive >= day_limit
+      || (duty_rules->week_drive_limit > 0 && totals.week_drive >= duty_rules->week_drive_limit)
+      || (duty_rules->fortnight_drive_limit > 0 && totals.fortnight_drive >= duty_rules->fortnight_drive_limit);
+}
+
+// Finish the current activity, logging and totalling it, and go off duty
+static void leave_activity() {
+  duty_revision++;
+  if(duty->activity == DUTY_OFF) {
+    return;
+  }
+  const ActivityInfo* info = &activities[duty->activity];
+  duty_log_append(info->stop, time(NULL));
+  duty_totals_add(info->total, duty->activity_mark / 1000, time(NULL));
+  DutyClock* clock = activity_clock(duty->activity);
+  if(clock != NULL) {
+    clock_stop(clock, epoch_ms());
+  }
+  duty->activity = DUTY_OFF;
+}
+
+static uint8_t enter_activity(uint8_t activity) {
+  duty_revision++;
+  if(activity == DUTY_OFF) {
+    return 0;
+  }
+  const ActivityInfo* info = &activities[activity];
+  duty->activity = activity;
+  duty->activity_mark = epoch_ms();
+  duty_log_append(info->start, time(NULL));
+  DutyClock* clock = activity_clock(activity);
+  if(clock != NULL) {
+    clock_start(clock, duty->activity_mark);
+  }
+  return info->work && over_duty_limits(activity == DUTY_DRIVE) ? DUTY_NOTIFY_OVER_LIMIT : 0;
+}
+
+// Go off duty and zero both clocks, logging why
+static void reset_clocks(DutyEvent reason) {
+  leave_activity();
+  int64_t now = epoch_ms();
+  clock_set(&duty->drive, 0, now);
+  clock_set(&duty->rest, 0, now);
+  duty->drive_alarmed = 0;
+  duty->rest_alarmed = 0;
+  duty_log_append(reason, time(NULL));
+}
+
+// Called off duty: a full break resets both clocks, an unfinished one keeps only what counts
+// towards a split break
+static void settle_break() {
+  int64_t now = epoch_ms();
+  int32_t rest_seconds = clock_elapsed(&duty->rest, now) / 1000;
+  if(rest_seconds >= duty_rules->break_total) {
+    reset_clocks(DUTY_EVENT_BREAK_RESET);
+  } else {
+    duty->rest_alarmed = rules_break_credit(duty_rules, rest_seconds);
+    clock_set(&duty->rest, duty->rest_alarmed * 1000, now);
+  }
+}
+
+uint8_t duty_press(DutyPress press) {
+  const Transition* transition = &transitions[duty->activity][press];
+  leave_activity();
+  if(transition->effects & SETTLE_BREAK) {
+    settle_break();
+  }
+  uint8_t notify = enter_activity(transition->to);
+  duty_checkpoint();
+  return notify;
+}
+
+void duty_reset() {
+  reset_clocks(DUTY_EVENT_RESET);
+  duty_checkpoint();
+}
+
+// Clocks keep their start times, so switching modes loses nothing. Settings belong to the
+// watch rather than a driver, so every profile follows them.
+void duty_apply_settings(bool battery_setting, bool rules_setting, uint8_t motion_mode) {
+  if(motion_mode < MOTION_MODES && motion_mode != duty_motion_mode) {
+    duty_motion_mode = motion_mode;
+    status_t status = persist_write_int(PERSIST_MOTION, motion_mode);
+    perf_persist_written(status, sizeof(int32_t));
+  }
+  DutyState* active = duty;
+  for(uint8_t i = 0; i < DUTY_PROFILES; i++) {
+    duty = &profiles[i];
+    duty->battery_setting = battery_setting;
+    duty->rules_setting = rules_setting;
+    settle_alarms();
+  }
+  duty = active;
+  apply_rules();
+  duty_checkpoint();
+}
+
+// Only the active profile's clocks are watched for deadlines; the others keep counting and
+// catch up on anything they passed as soon as they are switched back to
+uint8_t duty_switch_profile(uint8_t profile) {
+  if(profile >= DUTY_PROFILES || profile == duty_profile) {
+    return 0;
+  }
+  // Only the active profile's deadlines are watched, so a driver handing over the wheel
+  // becomes available as co-driver rather than driving on unseen. Rest and other work carry
+  // on, and any deadline they pass is acted on late, once, when the profile is back.
+  if(duty->activity == DUTY_DRIVE) {
+    leave_activity();
+    enter_activity(DUTY_AVAILABLE);
+  }
+  // The one write a switch needs is the index itself
+  status_t status = persist_write_int(PERSIST_PROFILE, profile);
+  perf_persist_written(status, sizeof(int32_t));
+  select_profile(profile);
+  duty_log_append(DUTY_EVENT_PROFILE + profile, time(NULL));
+  return duty_advance();
+}
+
+// Driving motion only ever leads to driving, and stillness only out of it to rest. Other
+// work and availability are left to the driver, as they look the same as a rest.
+uint8_t duty_motion(MotionState state) {
+  DutyPress press;
+  if(state == MOTION_DRIVING && duty->activity != DUTY_DRIVE) {
+    press = DUTY_PRESS_DRIVE;
+  } else if(state == MOTION_STILL && duty->activity == DUTY_DRIVE) {
+    press = DUTY_PRESS_REST;
+  } else {
+    return 0;
+  }
+  if(duty_motion_mode == MOTION_APPLY) {
+    return duty_press(press) | DUTY_NOTIFY_MOTION;
+  }
+  return duty_motion_mode == MOTION_SUGGEST ? DUTY_NOTIFY_MOTION : 0;
+}
+
+uint8_t duty_advance() {
+  uint8_t notify = 0;
+  int64_t now = epoch_ms();
+
+  // Alert as each warning passes, and stop the clock past the limit
+  // The state is packed, so the alarm cursors go through locals
+  int32_t alarmed = duty->drive_alarmed;
+  uint8_t crossed = rules_cross_deadlines(&duty_drive_deadlines, &alarmed, clock_elapsed(&duty->drive, now) / 1000);
+  duty->drive_alarmed = alarmed;
+  if(crossed & (1 << DEADLINE_ALERT)) {
+    notify |= DUTY_NOTIFY_ALERT;
+  }
+  if(crossed & (1 << DEADLINE_DRIVE_LIMIT) && duty->activity == DUTY_DRIVE) {
+    leave_activity();
+  }
+
+  // Alert when a split break's first part or the whole break is done
+  alarmed = duty->rest_alarmed;
+  crossed = rules_cross_deadlines(&duty_rest_deadlines, &alarmed, clock_elapsed(&duty->rest, now) / 1000);
+  duty->rest_alarmed = alarmed;
+  if(crossed & (1 << DEADLINE_ALERT)) {
+    notify |= DUTY_NOTIFY_ALERT;
+  }
+  // Once the break is complete, stop and zero both clocks, so the next press has no break
+  // left to settle and the reset is logged once. A break already ended by a press is settled,
+  // and logged, by whichever press starts work again.
+  if(crossed & (1 << DEADLINE_BREAK_COMPLETE)) {
+    if(duty->activity == DUTY_REST) {
+      reset_clocks(DUTY_EVENT_BREAK_RESET);
+    } else {
+      clock_set(&duty->drive, 0, epoch_ms());
+      duty->drive_alarmed = 0;
+    }
+  }
+
+  // Every pass ends here; an unchanged state costs one compare
+  duty_checkpoint();
+  return notify;
+}
+
+static int32_t next_clock_change(const DutyClock* clock, int32_t period, const DeadlineList* deadlines, int64_t now) {
+  if(!clock->running) {
+    return -1;
+  }
+  int32_t elapsed = clock_elapsed(clock, now);
+  int32_t next = period > 0 ? (elapsed / period + 1) * period : -1;
+  const Deadline* deadline = rules_deadline_after(deadlines, elapsed / 1000);
+  if(deadline != NULL && (next < 0 || deadline->at * 1000 < next)) {
+    next = deadline->at * 1000;
+  }
+  return next < 0 ? -1 : next - elapsed;
+}
+
+DutyVibe duty_vibe(uint8_t notify) {
+  if(notify & DUTY_NOTIFY_OVER_LIMIT) {
+    return DUTY_VIBE_DOUBLE;
+  } else if(notify & DUTY_NOTIFY_ALERT) {
+    return DUTY_VIBE_SHORT;
+  } else if(notify & DUTY_NOTIFY_MOTION) {
+    return DUTY_VIBE_LONG;
+  }
+  return DUTY_VIBE_NONE;
+}
+
+bool duty_idle() {
+  if(duty_motion_mode != MOTION_OFF) {
+    return false;
+  }
+  for(uint8_t i = 0; i < DUTY_PROFILES; i++) {
+    if(profiles[i].drive.running || profiles[i].rest.running) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int32_t duty_next_change(int32_t period) {
+  int64_t now = epoch_ms();
+  int32_t wait = next_clock_change(&duty->drive, period, &duty_drive_deadlines, now);
+  int32_t rest_wait = next_clock_change(&duty->rest, period, &duty_rest_deadlines, now);
+  if(wait < 0 || (rest_wait >= 0 && rest_wait < wait)) {
+    wait = rest_wait;
+  }
+  return wait;
+}
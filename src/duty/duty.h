@@ -0,0 +1,146 @@
+#pragma once
+
+#include "sdk.h"
+#include "duty_clock.h"
+#include "rules.h"
+#include "motion.h"
+
+// The duty-state machine shared by the app and the background worker. Whichever of the two
+// owns the state drives it through these calls; the other only reads the checkpoints.
+
+#define PERSIST_STATE_LEGACY 1
+#define PERSIST_STATE_A 2
+#define PERSIST_STATE_B 3
+// Index of the active driver profile
+#define PERSIST_PROFILE 5
+// A and B checkpoint keys for each driver profile after the first, which uses the two above
+#define PERSIST_PROFILE_STATES 6
+
+// MotionMode setting
+#define PERSIST_MOTION 15
+// What the worker raised when it last opened the app to vibrate, as DUTY_NOTIFY bits
+#define PERSIST_LAUNCH_NOTIFY 26
+
+// Independent drivers sharing the watch, e.g. when double manned
+#define DUTY_PROFILES 4
+
+// What the driver is doing. Driving and rest each run their own clock; other work and
+// availability are only timed for the totals.
+typedef enum {
+  DUTY_OFF = 0,
+  DUTY_DRIVE,
+  DUTY_REST,
+  DUTY_OTHER_WORK,
+  DUTY_AVAILABLE,
+  DUTY_ACTIVITIES,
+} DutyActivity;
+
+// The buttons that move between activities
+typedef enum {
+  DUTY_PRESS_DRIVE = 0,
+  DUTY_PRESS_REST,
+  DUTY_PRESS_WORK,
+  DUTY_PRESSES,
+} DutyPress;
+
+typedef struct {
+  DutyClock drive;
+  DutyClock rest;
+  // Whole seconds on each clock up to which deadlines have been acted on, so every alert
+  // fires exactly once even if it is checked late
+  int32_t drive_alarmed;
+  int32_t rest_alarmed;
+  bool battery_setting;
+  bool rules_setting;
+  // The current DutyActivity and the epoch time in milliseconds it began
+  uint8_t activity;
+  int64_t activity_mark;
+} __attribute__((__packed__)) DutyState;
+
+// What is done when the wrist starts or stops moving like it does in a cab
+typedef enum {
+  MOTION_OFF = 0,
+  MOTION_SUGGEST,
+  MOTION_APPLY,
+  MOTION_MODES,
+} MotionMode;
+
+// Bits returned by state changes for what the driver should be told
+#define DUTY_NOTIFY_ALERT (1 << 0)
+// Driving or other work started with the day, week or fortnight already used up
+#define DUTY_NOTIFY_OVER_LIMIT (1 << 1)
+// Motion suggests a change of activity, or made one in MOTION_APPLY mode
+#define DUTY_NOTIFY_MOTION (1 << 2)
+
+// How the driver is told about a set of DUTY_NOTIFY_ bits; the most urgent one wins
+typedef enum {
+  DUTY_VIBE_NONE = 0,
+  DUTY_VIBE_SHORT,
+  DUTY_VIBE_LONG,
+  DUTY_VIBE_DOUBLE,
+  DUTY_VIBES,
+} DutyVibe;
+
+// Messages between the app and the worker. The worker is the only writer while it runs; the
+// app forwards button presses and settings and reloads the checkpoint on DUTY_MSG_CHANGED.
+typedef enum {
+  // data0 the DutyPress
+  DUTY_MSG_PRESS = 1,
+  DUTY_MSG_RESET,
+  // data0 battery setting, data1 rules setting, data2 MotionMode
+  DUTY_MSG_SETTINGS,
+  // data0 the DUTY_NOTIFY_ bits raised by the change
+  DUTY_MSG_CHANGED,
+  // data0 the profile to switch to
+  DUTY_MSG_SWITCH_PROFILE,
+} DutyMessage;
+
+// The active profile's state, and its index
+extern DutyState* duty;
+extern uint8_t duty_profile;
+// The MotionMode, which like the other settings applies to every profile
+extern uint8_t duty_motion_mode;
+// Bumped by every transition, so a view can tell when anything derived from the state is due
+// to be worked out again
+extern uint32_t duty_revision;
+// The active rule set and its warning/limit deadlines for each clock
+extern const RuleSet* duty_rules;
+extern DeadlineList duty_drive_deadlines;
+extern DeadlineList duty_rest_deadlines;
+
+int64_t epoch_ms();
+
+// Open the log and totals and load the saved state of every profile; false if there was
+// none at all
+bool duty_init();
+void duty_deinit();
+
+// Reread the newest checkpoint without writing anything
+bool duty_load();
+
+// Save state now if the last checkpoint is old enough, otherwise once it is
+void duty_checkpoint();
+// Save state immediately, for a reader that is waiting on it
+void duty_save();
+
+// Move to whichever activity the transition table gives for a button in the current one
+uint8_t duty_press(DutyPress press);
+void duty_reset();
+void duty_apply_settings(bool battery_setting, bool rules_setting, uint8_t motion_mode);
+uint8_t duty_switch_profile(uint8_t profile);
+
+// Follow the motion detector into or out of driving, as far as the MotionMode allows
+uint8_t duty_motion(MotionState state);
+
+// Act on every deadline the running clocks have passed
+uint8_t duty_advance();
+
+DutyVibe duty_vibe(uint8_t notify);
+
+// No profile has a clock running and motion detection is off, so there is nothing for a
+// background worker to watch
+bool duty_idle();
+
+// Milliseconds until a running clock next crosses a multiple of period (0 for none) or one
+// of its deadlines, or -1 if nothing is ahead
+int32_t duty_next_change(int32_t period);
@@ -0,0 +1,37 @@
+#include "duty_clock.h"
+
+// Milliseconds on a clock at now. A wall clock stepping backwards counts as no time, and a
+// stale mark saturates rather than wrapping the 32-bit result.
+int32_t clock_elapsed(const DutyClock* clock, int64_t now) {
+  if(!clock->running) {
+    return clock->banked;
+  }
+  int64_t interval = now - clock->mark;
+  if(interval < 0) {
+    interval = 0;
+  }
+  if(interval > CLOCK_MAX_MS - clock->banked) {
+    return CLOCK_MAX_MS;
+  }
+  return clock->banked + (int32_t)interval;
+}
+
+void clock_start(DutyClock* clock, int64_t now) {
+  if(!clock->running) {
+    clock->running = true;
+    clock->mark = now;
+  }
+}
+
+void clock_stop(DutyClock* clock, int64_t now) {
+  if(clock->running) {
+    clock->banked = clock_elapsed(clock, now);
+    clock->running = false;
+  }
+}
+
+// Put a clock at elapsed milliseconds without changing whether it runs
+void clock_set(DutyClock* clock, int32_t elapsed, int64_t now) {
+  clock->banked = elapsed;
+  clock->mark = now;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A clock banks whole milliseconds while stopped and counts from mark, an epoch time in
+// milliseconds, while running. All of it is integer maths; the watch has no double FPU.
+// Callers pass the time in, so nothing here touches the SDK and a clock can be driven
+// from any time source.
+typedef struct {
+  bool running;
+  int32_t banked;
+  int64_t mark;
+} __attribute__((__packed__)) DutyClock;
+
+#define CLOCK_MAX_MS INT32_MAX
+
+int32_t clock_elapsed(const DutyClock* clock, int64_t now);
+void clock_start(DutyClock* clock, int64_t now);
+void clock_stop(DutyClock* clock, int64_t now);
+void clock_set(DutyClock* clock, int32_t elapsed, int64_t now);
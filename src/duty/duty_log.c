@@ -0,0 +1,150 @@
+#include "sdk.h"
+#include "duty_log.h"
+#include "perf.h"
+
+// Writes are deferred so a button press never waits on flash, and bursts of events from
+// one press land in a single write
+#define LOG_FLUSH_DELAY 2000
+
+// Every event is one varint of (seconds since the previous event << 4 | event)
+#define EVENT_BITS 4
+#define MAX_DELTA (UINT32_MAX >> EVENT_BITS)
+
+typedef struct {
+  uint32_t seq;
+  uint32_t base;
+  uint32_t last;
+  uint8_t used;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH - 13];
+} __attribute__((__packed__)) LogBlock;
+
+#define BLOCK_HEADER_SIZE offsetof(LogBlock, data)
+
+static LogBlock head;
+static uint8_t head_index = 0;
+static bool head_dirty = false;
+static AppTimer* flush_timer = NULL;
+
+static uint8_t encode_varint(uint32_t value, uint8_t* out) {
+  uint8_t length = 0;
+  while(value >= 0x80) {
+    out[length++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = value;
+  return length;
+}
+
+static void flush_head() {
+  if(flush_timer != NULL) {
+    app_timer_cancel(flush_timer);
+    flush_timer = NULL;
+  }
+  if(!head_dirty) {
+    return;
+  }
+  status_t status = persist_write_data(PERSIST_LOG_FIRST + head_index, &head, BLOCK_HEADER_SIZE + head.used);
+  perf_persist_written(status, BLOCK_HEADER_SIZE + head.used);
+  if(status < S_SUCCESS) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Failed to persist duty log: %ld", status);
+  }
+  head_dirty = false;
+}
+
+static void handle_flush_timer(void* data) {
+  flush_timer = NULL;
+  flush_head();
+}
+
+// The newest block is the one with the highest sequence number, so there is no separate
+// index key that could disagree with the blocks after a crash
+void duty_log_init() {
+  LogBlock block;
+  bool found = false;
+  memset(&head, 0, sizeof(head));
+  for(uint8_t i = 0; i < DUTY_LOG_BLOCKS; i++) {
+    int read = persist_read_data(PERSIST_LOG_FIRST + i, &block, sizeof(block));
+    if(read < (int)BLOCK_HEADER_SIZE || block.used > sizeof(block.data)) {
+      continue;
+    }
+    if(!found || (int32_t)(block.seq - head.seq) > 0) {
+      head = block;
+      head_index = i;
+      found = true;
+    }
+  }
+}
+
+void duty_log_deinit() {
+  flush_head();
+}
+
+void duty_log_flush() {
+  flush_head();
+}
+
+// Only headers are read while searching, so at most one block is ever held in RAM
+size_t duty_log_read_from(uint32_t from, uint8_t* buffer, uint32_t* seq, bool* newest) {
+  LogBlock header;
+  int8_t oldest = -1;
+  int8_t latest = -1;
+  uint32_t oldest_seq = 0;
+  uint32_t latest_seq = 0;
+  for(uint8_t i = 0; i < DUTY_LOG_BLOCKS; i++) {
+    int read = persist_read_data(PERSIST_LOG_FIRST + i, &header, BLOCK_HEADER_SIZE);
+    if(read < (int)BLOCK_HEADER_SIZE || header.used > sizeof(header.data)) {
+      continue;
+    }
+    if(latest < 0 || (int32_t)(header.seq - latest_seq) > 0) {
+      latest = i;
+      latest_seq = header.seq;
+    }
+    if((int32_t)(header.seq - from) >= 0 && (oldest < 0 || (int32_t)(header.seq - oldest_seq) < 0)) {
+      oldest = i;
+      oldest_seq = header.seq;
+    }
+  }
+  if(oldest < 0) {
+    return 0;
+  }
+  int read = persist_read_data(PERSIST_LOG_FIRST + oldest, buffer, DUTY_LOG_BLOCK_SIZE);
+  if(read < (int)BLOCK_HEADER_SIZE) {
+    return 0;
+  }
+  *seq = oldest_seq;
+  *newest = oldest == latest;
+  return read;
+}
+
+void duty_log_append(DutyEvent event, time_t when) {
+  uint32_t now = (uint32_t)when;
+  if(head.used == 0) {
+    head.base = now;
+    head.last = now;
+  }
+  uint32_t delta = now > head.last ? now - head.last : 0;
+  if(delta > MAX_DELTA) {
+    delta = MAX_DELTA;
+  }
+
+  uint8_t encoded[5];
+  uint8_t length = encode_varint(delta << EVENT_BITS | event, encoded);
+  if(head.used + length > sizeof(head.data)) {
+    // Start the next block, overwriting the oldest once the ring is full
+    flush_head();
+    head_index = (head_index + 1) % DUTY_LOG_BLOCKS;
+    head.seq++;
+    head.base = now;
+    head.last = now;
+    head.used = 0;
+    length = encode_varint(event, encoded);
+  }
+
+  memcpy(head.data + head.used, encoded, length);
+  head.used += length;
+  head.last = now;
+  head_dirty = true;
+  if(flush_timer == NULL) {
+    flush_timer = app_timer_register(LOG_FLUSH_DELAY, handle_flush_timer, NULL);
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "sdk.h"
+
+// The duty log is a ring of DUTY_LOG_BLOCKS persist keys starting at PERSIST_LOG_FIRST.
+// Each block holds events delta-encoded against the one before, so appending only ever
+// rewrites the newest block.
+#define PERSIST_LOG_FIRST 16
+#define DUTY_LOG_BLOCKS 8
+
+typedef enum {
+  DUTY_EVENT_DRIVE_START = 0,
+  DUTY_EVENT_DRIVE_STOP = 1,
+  DUTY_EVENT_REST_START = 2,
+  DUTY_EVENT_REST_STOP = 3,
+  DUTY_EVENT_RESET = 4,
+  DUTY_EVENT_BREAK_RESET = 5,
+  DUTY_EVENT_WORK_START = 6,
+  DUTY_EVENT_WORK_STOP = 7,
+  // Switched to driver profile n, logged as DUTY_EVENT_PROFILE + n
+  DUTY_EVENT_PROFILE = 8,
+  DUTY_EVENT_AVAILABLE_START = 12,
+  DUTY_EVENT_AVAILABLE_STOP = 13,
+} DutyEvent;
+
+// Largest persisted block: a 13-byte header (seq, base and last time as little-endian
+// uint32, then the count of event bytes) followed by the events
+#define DUTY_LOG_BLOCK_SIZE PERSIST_DATA_MAX_LENGTH
+
+void duty_log_init();
+void duty_log_deinit();
+void duty_log_append(DutyEvent event, time_t when);
+// Write out any events still held back
+void duty_log_flush();
+
+// Copy the persisted block with the lowest sequence number at or after from into buffer,
+// straight from flash. Returns its length, or 0 if no block is that new.
+size_t duty_log_read_from(uint32_t from, uint8_t* buffer, uint32_t* seq, bool* newest);
@@ -0,0 +1,80 @@
+#include "sdk.h"
+#include "duty_totals.h"
+#include "perf.h"
+
+typedef struct {
+  uint16_t day;
+  uint32_t seconds[DUTY_TOTALS];
+} __attribute__((__packed__)) DaySummary;
+
+// Indexed by day number modulo TOTALS_DAYS; a slot holding another day counts as empty
+static DaySummary days[TOTALS_DAYS];
+static uint32_t totals_key = PERSIST_TOTALS;
+
+static int32_t utc_offset(time_t when) {
+  return localtime(&when)->tm_gmtoff;
+}
+
+// Local days since the epoch
+static uint16_t day_number(time_t when) {
+  return (when + utc_offset(when)) / SECONDS_PER_DAY;
+}
+
+static uint32_t day_total(uint16_t day, DutyTotal total) {
+  const DaySummary* summary = &days[day % TOTALS_DAYS];
+  return summary->day == day ? summary->seconds[total] : 0;
+}
+
+void duty_totals_init(uint8_t profile) {
+  totals_key = profile == 0 ? PERSIST_TOTALS : PERSIST_PROFILE_TOTALS + profile - 1;
+  if(persist_read_data(totals_key, days, sizeof(days)) != sizeof(days)) {
+    memset(days, 0, sizeof(days));
+  }
+}
+
+// Add a finished period, split at local midnight so each day gets its own share
+void duty_totals_add(DutyTotal total, time_t from, time_t to) {
+  while(from < to) {
+    uint16_t day = day_number(from);
+    time_t day_end = (time_t)(day + 1) * SECONDS_PER_DAY - utc_offset(from);
+    time_t until = to < day_end ? to : day_end;
+
+    DaySummary* summary = &days[day % TOTALS_DAYS];
+    if(summary->day != day) {
+      memset(summary, 0, sizeof(*summary));
+      summary->day = day;
+    }
+    summary->seconds[total] += until - from;
+    from = until;
+  }
+
+  status_t status = persist_write_data(totals_key, days, sizeof(days));
+  perf_persist_written(status, sizeof(days));
+  if(status < S_SUCCESS) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Failed to persist totals: %ld", status);
+  }
+}
+
+// Totals for the day, the week since Monday and the fortnight of this and last week
+void duty_totals_get(time_t now, int32_t day_drive_limit, DutyTotals* totals) {
+  uint16_t today = day_number(now);
+  uint16_t since_monday = (localtime(&now)->tm_wday + 6) % 7;
+  memset(totals, 0, sizeof(*totals));
+
+  totals->day_drive = day_total(today, DUTY_TOTAL_DRIVE);
+  totals->day_rest = day_total(today, DUTY_TOTAL_REST);
+  totals->day_work = totals->day_drive + day_total(today, DUTY_TOTAL_WORK);
+  for(uint16_t back = 0; back < since_monday + 8; back++) {
+    int32_t drive = day_total(today - back, DUTY_TOTAL_DRIVE);
+    totals->fortnight_drive += drive;
+    if(back > since_monday) {
+      continue;
+    }
+    totals->week_drive += drive;
+    totals->week_rest += day_total(today - back, DUTY_TOTAL_REST);
+    totals->week_work += drive + day_total(today - back, DUTY_TOTAL_WORK);
+    if(back > 0 && drive > day_drive_limit) {
+      totals->week_extended_days++;
+    }
+  }
+}
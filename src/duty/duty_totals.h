@@ -0,0 +1,36 @@
+#pragma once
+
+#include "sdk.h"
+
+// Finished driving, rest, other work and availability is rolled up into one summary per
+// local day, kept for the current and previous week. Each driver profile has its own key: the
+// first profile PERSIST_TOTALS, the rest from PERSIST_PROFILE_TOTALS.
+#define PERSIST_TOTALS 4
+#define PERSIST_PROFILE_TOTALS 12
+#define TOTALS_DAYS 14
+
+typedef enum {
+  DUTY_TOTAL_DRIVE = 0,
+  DUTY_TOTAL_REST = 1,
+  DUTY_TOTAL_WORK = 2,
+  DUTY_TOTAL_AVAILABLE = 3,
+  DUTY_TOTALS,
+} DutyTotal;
+
+typedef struct {
+  int32_t day_drive;
+  int32_t week_drive;
+  int32_t fortnight_drive;
+  int32_t day_rest;
+  int32_t week_rest;
+  // Driving and other work together, for the working-time limits
+  int32_t day_work;
+  int32_t week_work;
+  // Days earlier this week that went over the standard daily driving limit
+  uint8_t week_extended_days;
+} DutyTotals;
+
+// Load the totals for a driver profile; later additions go to the same profile
+void duty_totals_init(uint8_t profile);
+void duty_totals_add(DutyTotal total, time_t from, time_t to);
+void duty_totals_get(time_t now, int32_t day_drive_limit, DutyTotals* totals);
@@ -0,0 +1,89 @@
+#include <string.h>
+#include "motion.h"
+
+// A cab shakes the wrist a little all the time, walking swings it a lot and a parked driver
+// hardly at all. Vibration between the two thresholds leaves the window undecided.
+#define DRIVE_VIBRATION 300
+#define STILL_VIBRATION 100
+#define WALK_VARIANCE 40000
+
+// Windows in a row needed to change state: a minute to start driving, two to stop, so
+// traffic lights and slow queues do not count as a break
+#define DRIVE_WINDOWS 6
+#define STILL_WINDOWS 12
+
+void motion_init(Motion* motion) {
+  memset(motion, 0, sizeof(*motion));
+}
+
+static uint32_t isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while(bit > value) {
+    bit >>= 2;
+  }
+  while(bit != 0) {
+    if(value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Which state a finished window points to, or the current one if it is undecided
+static MotionState classify(const Motion* motion, MotionFeatures* features) {
+  int32_t mean = motion->magnitude_sum / motion->count;
+  int64_t variance = motion->magnitude_squares / motion->count - (int64_t)mean * mean;
+  int64_t vibration = motion->vibration / motion->count;
+  features->variance = variance > INT32_MAX ? INT32_MAX : (int32_t)variance;
+  features->vibration = vibration > INT32_MAX ? INT32_MAX : (int32_t)vibration;
+
+  if(features->vibration < STILL_VIBRATION) {
+    return MOTION_STILL;
+  }
+  if(features->vibration >= DRIVE_VIBRATION && features->variance <= WALK_VARIANCE) {
+    return MOTION_DRIVING;
+  }
+  return motion->state;
+}
+
+bool motion_add(Motion* motion, int16_t x, int16_t y, int16_t z) {
+  uint32_t magnitude = isqrt((int32_t)x * x + (int32_t)y * y + (int32_t)z * z);
+  motion->magnitude_sum += magnitude;
+  motion->magnitude_squares += (int64_t)magnitude * magnitude;
+  if(motion->has_last) {
+    int32_t dx = x - motion->last[0];
+    int32_t dy = y - motion->last[1];
+    int32_t dz = z - motion->last[2];
+    motion->vibration += dx * dx + dy * dy + dz * dz;
+  }
+  motion->last[0] = x;
+  motion->last[1] = y;
+  motion->last[2] = z;
+  motion->has_last = true;
+  if(++motion->count < MOTION_WINDOW) {
+    return false;
+  }
+
+  MotionState window = classify(motion, &motion->features);
+  motion->count = 0;
+  motion->magnitude_sum = 0;
+  motion->magnitude_squares = 0;
+  motion->vibration = 0;
+
+  if(window == motion->state) {
+    motion->streak = 0;
+    return false;
+  }
+  motion->streak++;
+  if(motion->streak < (window == MOTION_DRIVING ? DRIVE_WINDOWS : STILL_WINDOWS)) {
+    return false;
+  }
+  motion->state = window;
+  motion->streak = 0;
+  return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tells driving from standing still using accelerometer samples and integer maths only.
+// Like duty_clock, nothing here depends on the SDK, so recorded traces can be replayed
+// through it anywhere.
+typedef enum {
+  MOTION_STILL = 0,
+  MOTION_DRIVING,
+} MotionState;
+
+// Samples per window, 10 s at the rate the feed asks for
+#define MOTION_WINDOW 100
+
+typedef struct {
+  // Variance of the acceleration's magnitude, in milli-g squared
+  int32_t variance;
+  // Mean squared change between consecutive samples, in milli-g squared
+  int32_t vibration;
+} MotionFeatures;
+
+typedef struct {
+  // Sums over the window in progress, in milli-g
+  uint8_t count;
+  int32_t magnitude_sum;
+  int64_t magnitude_squares;
+  int64_t vibration;
+  int16_t last[3];
+  bool has_last;
+  // Whole windows in a row that pointed away from state
+  uint8_t streak;
+  MotionState state;
+  // Features of the last completed window, for tuning against traces
+  MotionFeatures features;
+} Motion;
+
+void motion_init(Motion* motion);
+// Add one sample in milli-g. Returns true when it completes a window that changes state.
+bool motion_add(Motion* motion, int16_t x, int16_t y, int16_t z);
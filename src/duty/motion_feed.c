@@ -0,0 +1,70 @@
+#include "sdk.h"
+#include "motion_feed.h"
+#include "duty.h"
+#include "perf.h"
+
+// The lowest rate the service offers, delivered in the largest batches it allows, so the
+// detector wakes the CPU once every 2.5 s rather than once per sample
+#define FEED_RATE ACCEL_SAMPLING_10HZ
+#define FEED_BATCH 25
+
+static Motion motion;
+static MotionState declared;
+static MotionNotify feed_notify = NULL;
+
+// The detector looks for a change away from what the driver last said they were doing, and
+// is only brought back into line when that changes. A suggestion the driver ignores is left
+// standing rather than made again every few windows.
+static void follow_activity() {
+  MotionState now = duty->activity == DUTY_DRIVE ? MOTION_DRIVING : MOTION_STILL;
+  if(now != declared) {
+    declared = now;
+    motion.state = now;
+    motion.streak = 0;
+  }
+}
+
+static void handle_samples(AccelData* data, uint32_t count) {
+  perf_handler_begin();
+  follow_activity();
+  bool changed = false;
+  for(uint32_t i = 0; i < count; i++) {
+    // Our own vibrations would look like a cab
+    if(data[i].did_vibrate) {
+      continue;
+    }
+    changed |= motion_add(&motion, data[i].x, data[i].y, data[i].z);
+  }
+  if(changed) {
+    uint8_t notify = duty_motion(motion.state);
+    if(notify != 0) {
+      feed_notify(notify);
+    }
+  }
+  perf_handler_end();
+}
+
+void motion_feed_update(MotionNotify notify) {
+  if(duty_motion_mode == MOTION_OFF) {
+    motion_feed_stop();
+    return;
+  }
+  if(feed_notify != NULL) {
+    feed_notify = notify;
+    return;
+  }
+  motion_init(&motion);
+  declared = motion.state;
+  follow_activity();
+  feed_notify = notify;
+  accel_data_service_subscribe(FEED_BATCH, handle_samples);
+  accel_service_set_sampling_rate(FEED_RATE);
+}
+
+void motion_feed_stop() {
+  if(feed_notify == NULL) {
+    return;
+  }
+  accel_data_service_unsubscribe();
+  feed_notify = NULL;
+}
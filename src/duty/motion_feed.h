@@ -0,0 +1,11 @@
+#pragma once
+
+#include "sdk.h"
+
+// Feeds the accelerometer to the motion detector in large batches while the MotionMode asks
+// for it, handing whatever duty_motion raises to a callback
+typedef void (*MotionNotify)(uint8_t notify);
+
+// Start or stop the feed to match duty_motion_mode
+void motion_feed_update(MotionNotify notify);
+void motion_feed_stop();
@@ -0,0 +1,126 @@
+#include "sdk.h"
+#include "perf.h"
+
+// Log a report at most this often, piggybacking on a wakeup that happens anyway
+#define PERF_REPORT_INTERVAL 3600
+
+#ifdef DUTY_WORKER
+#define PERF_KEY PERSIST_WORKER_PERF
+#else
+#define PERF_KEY PERSIST_PERF
+#endif
+
+static PerfMode modes[PERF_MODES];
+static uint8_t mode = 0;
+static time_t mode_since = 0;
+static time_t last_report = 0;
+static time_t handler_seconds;
+static uint16_t handler_ms;
+
+static uint32_t now_ms(time_t* seconds) {
+  uint16_t milliseconds;
+  time_ms(seconds, &milliseconds);
+  return milliseconds;
+}
+
+// Close the time spent in the current mode up to now
+static void settle_mode_time() {
+  time_t now = time(NULL);
+  if(mode_since != 0 && now > mode_since) {
+    modes[mode].seconds += now - mode_since;
+  }
+  mode_since = now;
+}
+
+void perf_load() {
+  if(persist_read_data(PERF_KEY, modes, sizeof(modes)) != sizeof(modes)) {
+    memset(modes, 0, sizeof(modes));
+  }
+}
+
+void perf_save() {
+  settle_mode_time();
+  status_t status = persist_write_data(PERF_KEY, modes, sizeof(modes));
+  perf_persist_written(status, sizeof(modes));
+}
+
+void perf_clear() {
+  memset(modes, 0, sizeof(modes));
+  mode_since = time(NULL);
+  last_report = mode_since;
+}
+
+void perf_set_mode(bool battery) {
+  settle_mode_time();
+  mode = battery ? 1 : 0;
+  if(last_report == 0) {
+    last_report = mode_since;
+  }
+}
+
+void perf_count(PerfCounter counter, uint32_t amount) {
+  modes[mode].counters[counter] += amount;
+}
+
+void perf_persist_written(status_t status, size_t bytes) {
+  if(status >= S_SUCCESS) {
+    modes[mode].counters[PERF_PERSIST_WRITE]++;
+    modes[mode].counters[PERF_PERSIST_BYTES] += bytes;
+  }
+}
+
+void perf_handler_begin() {
+  handler_ms = now_ms(&handler_seconds);
+  modes[mode].counters[PERF_WAKEUP]++;
+}
+
+void perf_handler_end() {
+  time_t seconds;
+  uint16_t milliseconds = now_ms(&seconds);
+  int32_t duration = (int32_t)(seconds - handler_seconds) * 1000 + milliseconds - handler_ms;
+  if(duration < 0) {
+    duration = 0;
+  }
+  PerfMode* current = &modes[mode];
+  current->handlers++;
+  current->handler_ms += duration;
+  if(duration > current->handler_max_ms) {
+    current->handler_max_ms = duration;
+  }
+  if(seconds - last_report >= PERF_REPORT_INTERVAL) {
+    perf_report();
+    perf_save();
+  }
+}
+
+static uint32_t per_hour(uint32_t count, uint32_t seconds) {
+  return seconds > 0 ? (uint32_t)((uint64_t)count * 3600 / seconds) : 0;
+}
+
+// Log one line per mode: rates per hour of that mode and the average and worst handler
+void perf_report() {
+  static const char* names[] = { "normal", "battery" };
+  settle_mode_time();
+  last_report = mode_since;
+  APP_LOG(APP_LOG_LEVEL_INFO, "mode     mins  wake/h  draw/h  writes/h  bytes/h  avg_us  max_ms");
+  for(uint8_t i = 0; i < ARRAY_LENGTH(modes); i++) {
+    const PerfMode* m = &modes[i];
+    APP_LOG(APP_LOG_LEVEL_INFO, "%-7s %5lu %7lu %7lu %9lu %8lu %7lu %7u", names[i],
+            (unsigned long)(m->seconds / 60),
+            (unsigned long)per_hour(m->counters[PERF_WAKEUP], m->seconds),
+            (unsigned long)per_hour(m->counters[PERF_REDRAW], m->seconds),
+            (unsigned long)per_hour(m->counters[PERF_PERSIST_WRITE], m->seconds),
+            (unsigned long)per_hour(m->counters[PERF_PERSIST_BYTES], m->seconds),
+            (unsigned long)(m->handlers > 0 ? m->handler_ms * 1000 / m->handlers : 0),
+            m->handler_max_ms);
+  }
+}
+
+void perf_get(PerfMode out[PERF_MODES]) {
+  settle_mode_time();
+  memcpy(out, modes, sizeof(modes));
+}
+
+bool perf_get_worker(PerfMode out[PERF_MODES]) {
+  return persist_read_data(PERSIST_WORKER_PERF, out, sizeof(modes)) == sizeof(modes);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "sdk.h"
+
+// Cheap running counters for what the app costs, kept separately for normal and battery
+// saving mode so the two can be compared from the same build. They carry on across launches
+// in PERSIST_PERF, or PERSIST_WORKER_PERF for the background worker's own.
+#define PERSIST_PERF 24
+#define PERSIST_WORKER_PERF 25
+
+typedef enum {
+  PERF_WAKEUP = 0,
+  PERF_REDRAW,
+  PERF_PERSIST_WRITE,
+  PERF_PERSIST_BYTES,
+  PERF_COUNTERS,
+} PerfCounter;
+
+typedef struct {
+  uint32_t counters[PERF_COUNTERS];
+  // Whole seconds spent in this mode, and handler time in milliseconds
+  uint32_t seconds;
+  uint32_t handlers;
+  uint32_t handler_ms;
+  uint16_t handler_max_ms;
+} __attribute__((__packed__)) PerfMode;
+
+#define PERF_MODES 2
+
+void perf_load();
+void perf_save();
+// Start every counter again from zero
+void perf_clear();
+void perf_set_mode(bool battery);
+void perf_count(PerfCounter counter, uint32_t amount);
+void perf_persist_written(status_t status, size_t bytes);
+void perf_handler_begin();
+void perf_handler_end();
+void perf_report();
+
+// Counters for both modes up to now, from this process or as the worker last saved them
+void perf_get(PerfMode modes[PERF_MODES]);
+bool perf_get_worker(PerfMode modes[PERF_MODES]);
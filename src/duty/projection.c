@@ -0,0 +1,27 @@
+#include "sdk.h"
+#include "projection.h"
+#include "duty.h"
+#include "duty_totals.h"
+
+static time_t project(time_t now, int32_t remaining) {
+  return now + (remaining > 0 ? remaining : 0);
+}
+
+void projection_compute(time_t now, Projection* projection) {
+  int64_t now_ms = (int64_t)now * 1000;
+  memset(projection, 0, sizeof(*projection));
+
+  if(duty->drive.running) {
+    projection->break_due = project(now, duty_rules->drive_limit - clock_elapsed(&duty->drive, now_ms) / 1000);
+
+    // Totals only hold finished driving, so the stretch in progress is added on
+    DutyTotals totals;
+    duty_totals_get(now, duty_rules->day_drive_limit, &totals);
+    int32_t day_limit = rules_day_drive_limit(duty_rules, totals.week_extended_days);
+    int32_t driving = now - (time_t)(duty->drive.mark / 1000);
+    projection->day_limit = project(now, day_limit - totals.day_drive - driving);
+  }
+  if(duty->rest.running) {
+    projection->rest_complete = project(now, duty_rules->break_total - clock_elapsed(&duty->rest, now_ms) / 1000);
+  }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "sdk.h"
+
+// Wall-clock times the current state is heading for, or 0 where a clock is not running.
+// They only move when the state does, so they are worked out once per transition.
+typedef struct {
+  // Continuous driving reaches the limit and a break is required
+  time_t break_due;
+  // The break in progress is complete
+  time_t rest_complete;
+  // Today's driving reaches the daily limit
+  time_t day_limit;
+} Projection;
+
+void projection_compute(time_t now, Projection* projection);
@@ -0,0 +1,105 @@
+#include "rules.h"
+
+static const RuleSet rule_sets[RULES_COUNT] = {
+  // EU HGV: 4h30 driving, then 45 minutes of break, which may be split 15 + 30. 9h a day,
+  // 10h on two days a week, 56h a week and 90h a fortnight. At most 60h of work a week.
+  [RULES_EU_HGV] = {
+    .drive_limit = 16200,
+    .break_total = 2700,
+    .break_split = 900,
+    .drive_warnings = { 3600, 1800, 1 },
+    .day_drive_limit = 32400,
+    .day_drive_extended = 36000,
+    .day_extensions = 2,
+    .week_drive_limit = 201600,
+    .fortnight_drive_limit = 324000,
+    .day_work_limit = 0,
+    .week_work_limit = 216000,
+  },
+  // GB domestic: 5h30 driving, then an unbroken 30 minute break. 10h a day, and 11h on
+  // duty a day.
+  [RULES_DOMESTIC] = {
+    .drive_limit = 19800,
+    .break_total = 1800,
+    .break_split = 0,
+    .drive_warnings = { 3600, 1800, 1 },
+    .day_drive_limit = 36000,
+    .day_drive_extended = 36000,
+    .day_extensions = 0,
+    .week_drive_limit = 0,
+    .fortnight_drive_limit = 0,
+    .day_work_limit = 39600,
+    .week_work_limit = 0,
+  },
+};
+
+const RuleSet* rules_get(RulesId id) {
+  return &rule_sets[id < RULES_COUNT ? id : RULES_EU_HGV];
+}
+
+// Insert keeping the list sorted by time
+static void add_deadline(DeadlineList* list, int32_t at, DeadlineAction action) {
+  uint8_t i = list->count;
+  while(i > 0 && list->items[i - 1].at > at) {
+    list->items[i] = list->items[i - 1];
+    i--;
+  }
+  list->items[i] = (Deadline){ .at = at, .action = action };
+  list->count++;
+}
+
+void rules_drive_deadlines(const RuleSet* rules, DeadlineList* list) {
+  list->count = 0;
+  for(int i = 0; i < RULE_DRIVE_WARNINGS; i++) {
+    add_deadline(list, rules->drive_limit - rules->drive_warnings[i], DEADLINE_ALERT);
+  }
+  add_deadline(list, rules->drive_limit + 1, DEADLINE_DRIVE_LIMIT);
+}
+
+void rules_rest_deadlines(const RuleSet* rules, DeadlineList* list) {
+  list->count = 0;
+  if(rules->break_split > 0) {
+    add_deadline(list, rules->break_split - 1, DEADLINE_ALERT);
+  }
+  add_deadline(list, rules->break_total - 1, DEADLINE_ALERT);
+  add_deadline(list, rules->break_total + 1, DEADLINE_BREAK_COMPLETE);
+}
+
+// Pass every deadline after *handled up to seconds exactly once, however late the check
+// comes. Moves *handled to the last deadline passed and returns a bit per action passed.
+uint8_t rules_cross_deadlines(const DeadlineList* list, int32_t* handled, int32_t seconds) {
+  uint8_t crossed = 0;
+  for(uint8_t i = 0; i < list->count && list->items[i].at <= seconds; i++) {
+    if(list->items[i].at > *handled) {
+      crossed |= 1 << list->items[i].action;
+      *handled = list->items[i].at;
+    }
+  }
+  return crossed;
+}
+
+// The first deadline strictly after seconds, or NULL if there are no more
+const Deadline* rules_deadline_after(const DeadlineList* list, int32_t seconds) {
+  for(uint8_t i = 0; i < list->count; i++) {
+    if(list->items[i].at > seconds) {
+      return &list->items[i];
+    }
+  }
+  return NULL;
+}
+
+// Seconds of an unfinished break that still count once driving resumes
+int32_t rules_break_credit(const RuleSet* rules, int32_t rest_seconds) {
+  if(rules->break_split > 0 && rest_seconds >= rules->break_split) {
+    return rules->break_split;
+  }
+  return 0;
+}
+
+// Today's driving limit, given how many extended days the week has already used
+int32_t rules_day_drive_limit(const RuleSet* rules, uint8_t extended_days) {
+  if(extended_days < rules->day_extensions) {
+    return rules->day_drive_extended;
+  }
+  return rules->day_drive_limit;
+}
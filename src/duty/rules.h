@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Each set of driving rules is one row of a const table rather than its own branches. Like
+// duty_clock, nothing here depends on the SDK.
+typedef enum {
+  RULES_EU_HGV = 0,
+  RULES_DOMESTIC = 1,
+  RULES_COUNT,
+} RulesId;
+
+#define RULE_DRIVE_WARNINGS 3
+
+typedef struct {
+  // Seconds of driving allowed before a break is due
+  int32_t drive_limit;
+  // Seconds of break that reset the drive clock
+  int32_t break_total;
+  // Seconds of a first split break kept towards break_total, 0 if breaks cannot be split
+  int32_t break_split;
+  // Warn when this many seconds of driving remain
+  int32_t drive_warnings[RULE_DRIVE_WARNINGS];
+  // Seconds of driving allowed in a day, and how many days a week may go up to the
+  // extended amount instead
+  int32_t day_drive_limit;
+  int32_t day_drive_extended;
+  uint8_t day_extensions;
+  // Seconds of driving allowed Monday to Sunday and over two such weeks, 0 for no limit
+  int32_t week_drive_limit;
+  int32_t fortnight_drive_limit;
+  // Seconds of driving and other work together allowed in a day and in a week, 0 for no limit
+  int32_t day_work_limit;
+  int32_t week_work_limit;
+} RuleSet;
+
+typedef enum {
+  DEADLINE_ALERT,
+  DEADLINE_DRIVE_LIMIT,
+  DEADLINE_BREAK_COMPLETE,
+} DeadlineAction;
+
+// A moment, in whole seconds on a clock, when something has to happen
+typedef struct {
+  int32_t at;
+  DeadlineAction action;
+} Deadline;
+
+#define RULE_MAX_DEADLINES (RULE_DRIVE_WARNINGS + 2)
+
+// Deadlines for one clock in ascending order, built once per rule change
+typedef struct {
+  Deadline items[RULE_MAX_DEADLINES];
+  uint8_t count;
+} DeadlineList;
+
+const RuleSet* rules_get(RulesId id);
+void rules_drive_deadlines(const RuleSet* rules, DeadlineList* list);
+void rules_rest_deadlines(const RuleSet* rules, DeadlineList* list);
+uint8_t rules_cross_deadlines(const DeadlineList* list, int32_t* handled, int32_t seconds);
+const Deadline* rules_deadline_after(const DeadlineList* list, int32_t seconds);
+int32_t rules_break_credit(const RuleSet* rules, int32_t rest_seconds);
+int32_t rules_day_drive_limit(const RuleSet* rules, uint8_t extended_days);
@@ -0,0 +1,11 @@
+#pragma once
+
+// The duty engine is built into both the app and the background worker, which see the SDK
+// through different headers, and into host tools through a stand-in
+#ifdef DUTY_WORKER
+#include <pebble_worker.h>
+#elif defined(DUTY_HOST)
+#include "host_sdk.h"
+#else
+#include <pebble.h>
+#endif
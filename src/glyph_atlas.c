@@ -0,0 +1,77 @@
+#include <pebble.h>
+#include "glyph_atlas.h"
+
+// The whole resource stays loaded, as the atlas bitmap draws straight from it
+static uint8_t* data = NULL;
+static GBitmap* atlas = NULL;
+static GBitmap* glyphs[ATLAS_SIZES][ATLAS_GLYPHS];
+
+static const AtlasHeader* header() {
+  return (const AtlasHeader*)data;
+}
+
+bool glyph_atlas_load(uint32_t resource_id) {
+  ResHandle handle = resource_get_handle(resource_id);
+  size_t size = resource_size(handle);
+  if(size <= sizeof(AtlasHeader)) {
+    return false;
+  }
+  data = malloc(size);
+  if(data == NULL) {
+    return false;
+  }
+  resource_load(handle, data, size);
+  if(memcmp(header()->chars, ATLAS_CHARS, ATLAS_GLYPHS) != 0) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Glyph atlas does not match ATLAS_CHARS.");
+    glyph_atlas_unload();
+    return false;
+  }
+
+  // One sub-bitmap per cell, so drawing a glyph is a single bitmap blit
+  atlas = gbitmap_create_with_data(data + sizeof(AtlasHeader));
+  for(uint8_t s = 0; s < ATLAS_SIZES; s++) {
+    const AtlasMetrics* metrics = &header()->sizes[s];
+    for(uint8_t i = 0; i < ATLAS_GLYPHS; i++) {
+      GRect cell = GRect(metrics->x[i], metrics->y, metrics->advance[i], metrics->height);
+      glyphs[s][i] = gbitmap_create_as_sub_bitmap(atlas, cell);
+    }
+  }
+  return true;
+}
+
+void glyph_atlas_unload() {
+  if(atlas != NULL) {
+    for(uint8_t s = 0; s < ATLAS_SIZES; s++) {
+      for(uint8_t i = 0; i < ATLAS_GLYPHS; i++) {
+        gbitmap_destroy(glyphs[s][i]);
+      }
+    }
+    gbitmap_destroy(atlas);
+    atlas = NULL;
+  }
+  free(data);
+  data = NULL;
+}
+
+static int8_t glyph_index(char c) {
+  if(c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  const char* found = strchr(ATLAS_CHARS, c);
+  return found != NULL && c != '\0' ? found - ATLAS_CHARS : -1;
+}
+
+void glyph_atlas_draw(GContext* ctx, AtlasSize size, const char* text, GPoint origin) {
+  const AtlasMetrics* metrics = &header()->sizes[size];
+  GRect cell = GRect(origin.x, origin.y + metrics->top, 0, metrics->height);
+  graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+  for(const char* c = text; *c != '\0'; c++) {
+    int8_t i = glyph_index(*c);
+    if(i < 0) {
+      continue;
+    }
+    cell.size.w = metrics->advance[i];
+    graphics_draw_bitmap_in_rect(ctx, glyphs[size][i], cell);
+    cell.origin.x += cell.size.w;
+  }
+}
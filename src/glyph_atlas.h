@@ -0,0 +1,37 @@
+#pragma once
+
+#include <pebble.h>
+
+// Timer digits pre-rendered by tools/glyph_atlas.py into one 1-bit bitmap, drawn glyph by
+// glyph at fixed advances instead of through the font engine
+#define ATLAS_CHARS "0123456789:-"
+#define ATLAS_GLYPHS 12
+
+typedef enum {
+  ATLAS_LARGE = 0,
+  ATLAS_SMALL,
+  ATLAS_SIZES,
+} AtlasSize;
+
+// Where each glyph of one size sits in the atlas. Top is the rows from the top of the line
+// box to the first row of the cells, so text lands where the font engine put it.
+typedef struct {
+  uint8_t top;
+  uint8_t height;
+  uint8_t advance[ATLAS_GLYPHS];
+  uint16_t x[ATLAS_GLYPHS];
+  uint16_t y;
+} __attribute__((__packed__)) AtlasMetrics;
+
+// The resource: this header, then the atlas as a .pbi image. The header is a multiple of four
+// bytes long, so the image's rows stay word aligned.
+typedef struct {
+  char chars[ATLAS_GLYPHS];
+  AtlasMetrics sizes[ATLAS_SIZES];
+} __attribute__((__packed__)) AtlasHeader;
+
+bool glyph_atlas_load(uint32_t resource_id);
+void glyph_atlas_unload();
+
+// Draw text with its line box at origin; characters not in the atlas advance nothing
+void glyph_atlas_draw(GContext* ctx, AtlasSize size, const char* text, GPoint origin);
@@ -0,0 +1,104 @@
+#include <pebble.h>
+#include "log_export.h"
+#include "duty/duty_log.h"
+
+// A block that is not acknowledged in time is sent again, a few times at most; after that
+// the phone resumes with a new request the next time it connects
+#define EXPORT_ACK_TIMEOUT 5000
+#define EXPORT_MAX_ATTEMPTS 4
+
+static bool exporting = false;
+// First sequence number still to send, and what was sent last
+static uint32_t next_seq;
+static uint32_t sent_seq;
+static bool sent_newest;
+static uint8_t attempts;
+static AppTimer* ack_timer = NULL;
+
+static void send_block();
+
+static void handle_ack_timeout(void* data) {
+  ack_timer = NULL;
+  if(++attempts >= EXPORT_MAX_ATTEMPTS) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Duty log export gave up at block %lu.", (unsigned long)next_seq);
+    exporting = false;
+    return;
+  }
+  send_block();
+}
+
+// Read the next block straight from flash into the outbox. An empty log is reported as a
+// newest marker with no block, which the phone has nothing to acknowledge, so the export ends
+// there.
+static void send_block() {
+  if(ack_timer != NULL) {
+    app_timer_cancel(ack_timer);
+    ack_timer = NULL;
+  }
+
+  DictionaryIterator* out;
+  if(app_message_outbox_begin(&out) != APP_MSG_OK) {
+    // Something else is in flight; the timeout tries again
+    ack_timer = app_timer_register(EXPORT_ACK_TIMEOUT, handle_ack_timeout, NULL);
+    return;
+  }
+  uint8_t block[DUTY_LOG_BLOCK_SIZE];
+  size_t length = duty_log_read_from(next_seq, block, &sent_seq, &sent_newest);
+  if(length > 0) {
+    dict_write_data(out, KEY_EXPORT_BLOCK, block, length);
+  } else {
+    sent_seq = next_seq;
+    sent_newest = true;
+  }
+  dict_write_uint8(out, KEY_EXPORT_NEWEST, sent_newest);
+  app_message_outbox_send();
+  if(length == 0) {
+    exporting = false;
+    return;
+  }
+  ack_timer = app_timer_register(EXPORT_ACK_TIMEOUT, handle_ack_timeout, NULL);
+}
+
+uint32_t log_export_outbox_size() {
+  return dict_calc_buffer_size(2, DUTY_LOG_BLOCK_SIZE, sizeof(uint8_t));
+}
+
+bool log_export_received(DictionaryIterator* iterator) {
+  Tuple* t = dict_find(iterator, KEY_EXPORT_REQUEST);
+  if(t != NULL) {
+    // Whatever the watch still holds back goes out first, so the newest block is complete
+    duty_log_flush();
+    exporting = true;
+    next_seq = t->value->uint32;
+    attempts = 0;
+    send_block();
+    return true;
+  }
+
+  t = dict_find(iterator, KEY_EXPORT_ACK);
+  if(t == NULL) {
+    return false;
+  }
+  if(!exporting || t->value->uint32 != sent_seq) {
+    // A stale acknowledgement for a block already resent
+    return true;
+  }
+  if(sent_newest) {
+    app_timer_cancel(ack_timer);
+    ack_timer = NULL;
+    exporting = false;
+    return true;
+  }
+  next_seq = sent_seq + 1;
+  attempts = 0;
+  send_block();
+  return true;
+}
+
+void log_export_deinit() {
+  if(ack_timer != NULL) {
+    app_timer_cancel(ack_timer);
+    ack_timer = NULL;
+  }
+  exporting = false;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <pebble.h>
+
+// Sends the duty log to the phone one persisted block per message. The phone asks with
+// KEY_EXPORT_REQUEST for every block from a sequence number on, and acknowledges each block
+// with KEY_EXPORT_ACK before the next is sent. Blocks keep their sequence numbers across
+// launches, so an interrupted export resumes from the last block the phone saved.
+#define KEY_EXPORT_REQUEST 3
+#define KEY_EXPORT_ACK 4
+#define KEY_EXPORT_BLOCK 5
+#define KEY_EXPORT_NEWEST 6
+
+// Outbox room for the largest export message
+uint32_t log_export_outbox_size();
+
+// Handle an export request or acknowledgement; false if the message was neither
+bool log_export_received(DictionaryIterator* iterator);
+void log_export_deinit();
@@ -1,35 +1,198 @@
-var battery;
-var rules;
+// Binary settings message, see KEY_SETTINGS in stopwatch.c
+var KEY_SETTINGS = 2;
+var SETTINGS_PROTOCOL = 2;
+var SETTING_BATTERY = 1 << 0;
+var SETTING_RULES = 1 << 1;
+var SETTING_MOTION = 1 << 2;
+var RULES_EU_HGV = 0;
+var RULES_DOMESTIC = 1;
+var MOTION_MODES = ['off', 'suggest', 'apply'];
+
+// Pack the config page's answers as [version, fields present, flags, rule set, motion mode]
+function encodeSettings(configuration) {
+  var present = 0;
+  var flags = 0;
+  var rulesId = RULES_EU_HGV;
+  if(configuration.seconds === 'on' || configuration.seconds === 'off') {
+    present |= SETTING_BATTERY;
+    if(configuration.seconds === 'on') {
+      flags |= SETTING_BATTERY;
+    }
+  }
+  if(configuration.rules === 'driving' || configuration.rules === 'domestic') {
+    present |= SETTING_RULES;
+    if(configuration.rules === 'domestic') {
+      rulesId = RULES_DOMESTIC;
+    }
+  }
+  var motionMode = MOTION_MODES.indexOf(configuration.motion);
+  if(motionMode >= 0) {
+    present |= SETTING_MOTION;
+  } else {
+    motionMode = 0;
+  }
+  return [SETTINGS_PROTOCOL, present, flags, rulesId, motionMode];
+}
+
+// Duty log export, see log_export.h. Blocks are kept by sequence number in localStorage
+// as 'dutyLog' (JSON) and rendered to 'dutyLogCsv' after each one arrives.
+var KEY_EXPORT_REQUEST = 3;
+var KEY_EXPORT_ACK = 4;
+var KEY_EXPORT_BLOCK = 5;
+var KEY_EXPORT_NEWEST = 6;
+var EVENT_NAMES = ['drive_start', 'drive_stop', 'rest_start', 'rest_stop', 'reset', 'break_reset',
+                   'work_start', 'work_stop'];
+EVENT_NAMES[12] = 'available_start';
+EVENT_NAMES[13] = 'available_stop';
+// Events from this one for DRIVER_PROFILES events switch to driver profile n + 1
+var EVENT_PROFILE = 8;
+var DRIVER_PROFILES = 4;
+
+function eventName(event) {
+  if(event >= EVENT_PROFILE && event < EVENT_PROFILE + DRIVER_PROFILES) {
+    return 'driver_' + (event - EVENT_PROFILE + 1);
+  }
+  return EVENT_NAMES[event] || event;
+}
+
+// Payload keys arrive as appKey names, or as numbers for keys the SDK does not know
+function payloadField(payload, name, key) {
+  return payload[name] !== undefined ? payload[name] : payload[key];
+}
+
+function readUint32(bytes, offset) {
+  return (bytes[offset] | bytes[offset + 1] << 8 | bytes[offset + 2] << 16) + bytes[offset + 3] * 0x1000000;
+}
+
+// Decode one block: a header of seq, base, last (uint32) and used (uint8), then one varint
+// of (seconds since the previous event << 4 | event) per event
+function decodeBlock(bytes) {
+  var block = { seq: readUint32(bytes, 0), events: [] };
+  var time = readUint32(bytes, 4);
+  var end = 13 + bytes[12];
+  var value = 0;
+  var scale = 1;
+  for(var i = 13; i < end && i < bytes.length; i++) {
+    value += (bytes[i] & 0x7f) * scale;
+    scale *= 128;
+    if((bytes[i] & 0x80) === 0) {
+      time += Math.floor(value / 16);
+      block.events.push([time, value % 16]);
+      value = 0;
+      scale = 1;
+    }
+  }
+  return block;
+}
+
+function saveDutyLog(log) {
+  var seqs = Object.keys(log).map(Number).sort(function(a, b) { return a - b; });
+  var csv = 'time,event\n';
+  seqs.forEach(function(seq) {
+    log[seq].forEach(function(event) {
+      csv += new Date(event[0] * 1000).toISOString() + ',' + eventName(event[1]) + '\n';
+    });
+  });
+  window.localStorage.setItem('dutyLog', JSON.stringify(log));
+  window.localStorage.setItem('dutyLogCsv', csv);
+}
+
+// Ask for every block from the last one saved; that one is fetched again as it may have
+// grown since
+function requestDutyLog() {
+  var next = parseInt(window.localStorage.getItem('dutyLogNext'), 10) || 0;
+  var message = {};
+  message[KEY_EXPORT_REQUEST] = next;
+  Pebble.sendAppMessage(message, null, function(e) {
+    console.log("Requesting duty log failed!");
+  });
+}
+
+function receiveDutyLog(payload) {
+  var bytes = payloadField(payload, 'KEY_EXPORT_BLOCK', KEY_EXPORT_BLOCK);
+  var newest = payloadField(payload, 'KEY_EXPORT_NEWEST', KEY_EXPORT_NEWEST);
+  if(bytes === undefined) {
+    console.log("Duty log is empty.");
+    return;
+  }
+  var block = decodeBlock(bytes);
+  var log = JSON.parse(window.localStorage.getItem('dutyLog') || '{}');
+  log[block.seq] = block.events;
+  saveDutyLog(log);
+  window.localStorage.setItem('dutyLogNext', newest ? block.seq : block.seq + 1);
+
+  // Saved before acknowledging, so a dropped connection resumes at the next block
+  var message = {};
+  message[KEY_EXPORT_ACK] = block.seq;
+  Pebble.sendAppMessage(message, null, function(e) {
+    console.log("Acknowledging duty log block " + block.seq + " failed!");
+  });
+}
 
 Pebble.addEventListener("ready",
   function(e) {
     console.log("PebbleKit JS ready!");
+    requestDutyLog();
+  }
+);
+
+Pebble.addEventListener("appmessage",
+  function(e) {
+    if(payloadField(e.payload, 'KEY_EXPORT_NEWEST', KEY_EXPORT_NEWEST) !== undefined) {
+      receiveDutyLog(e.payload);
+    }
   }
 );
 
+// Settings the watch was last sent, as the config page's answers, and the localStorage
+// key each is kept under
+var SETTINGS_STORAGE = { seconds: 'battery', rules: 'rules', motion: 'motion' };
+var SETTINGS_NAMES = Object.keys(SETTINGS_STORAGE);
+
+function savedSettings() {
+  var saved = {};
+  SETTINGS_NAMES.forEach(function(name) {
+    var value = window.localStorage.getItem(SETTINGS_STORAGE[name]);
+    if(value !== null && value !== 'undefined' && value !== 'null') {
+      saved[name] = value;
+    }
+  });
+  return saved;
+}
+
 Pebble.addEventListener("showConfiguration",
   function(e) {
-    //Load the remote config page and settings from JS
-    battery = window.localStorage.getItem('battery');
-    rules = window.localStorage.getItem('rules');
-    Pebble.openURL("http://sephallen.github.io/DriverTimer/index.html?battery=" + battery + "&rules=" + rules);
+    // The page is bundled as a data: URI (CONFIG_PAGE, made by the wscript), so it opens
+    // without a network connection
+    var settings = encodeURIComponent(JSON.stringify(savedSettings()));
+    Pebble.openURL(CONFIG_PAGE.replace('__SETTINGS__', encodeURIComponent(settings)));
   }
 );
 
-	
 Pebble.addEventListener("webviewclosed",
   function(e) {
-    
-    //Get JSON dictionary
+    if(!e.response) {
+      return;
+    }
+    // The page only returns the answers that changed
     var configuration = JSON.parse(decodeURIComponent(e.response));
     console.log("Configuration window returned: " + JSON.stringify(configuration));
-    // Store settings in JS
-    window.localStorage.setItem('battery', configuration.seconds);
-    window.localStorage.setItem('rules', configuration.rules);
- 
+    var changed = false;
+    SETTINGS_NAMES.forEach(function(name) {
+      if(configuration[name] !== undefined) {
+        window.localStorage.setItem(SETTINGS_STORAGE[name], configuration[name]);
+        changed = true;
+      }
+    });
+    if(!changed) {
+      return;
+    }
+
     //Send to Pebble, persist there
+    var message = {};
+    message[KEY_SETTINGS] = encodeSettings(configuration);
     Pebble.sendAppMessage(
-      {'0': configuration.seconds, '1': configuration.rules},
+      message,
       function(e) {
         console.log("Sending settings data...");
       },
@@ -38,4 +201,4 @@ Pebble.addEventListener("webviewclosed",
       }
     );
   }
-);
\ No newline at end of file
+);
@@ -26,244 +26,224 @@
  */
 
 #include <pebble.h>
+#include "clock_view.h"
+#include "dashboard.h"
+#include "diagnostics.h"
+#include "duty/duty.h"
+#include "duty/motion_feed.h"
+#include "duty/perf.h"
+#include "duty/projection.h"
+#include "log_export.h"
 
 static Window* window;
-static Window* reset_confirm;
-
-// Main display
-static TextLayer* drive_time_label_layer;
-static TextLayer* big_time_layer;
-static TextLayer* drive_remaining_label_layer;
-static TextLayer* remaining_drive_layer;
-static TextLayer* rest_time_label_layer;
-static TextLayer* big_rest_layer;
-static TextLayer* rest_remaining_label_layer;
-static TextLayer* remaining_rest_layer;
-static TextLayer* reset_warning_label_layer;
-static GFont large_font;
-static GFont small_font;
-static GFont label_font;
+static Window* reset_confirm = NULL;
+
+// Main display, drawn by the dashboard layer
 ActionBarLayer *action_bar;
 static GBitmap* drive_button;
 static GBitmap* rest_button;
 static GBitmap* reset_button;
-static GBitmap* confirm_button;
 
 // Reset confirmation display
+static GFont reset_font;
+static TextLayer* reset_warning_label_layer;
 ActionBarLayer *action_bar_reset;
+static GBitmap* confirm_button;
 
-// Actually keeping track of time
-static double elapsed_time = 0;
-static bool started = false;
+// Each clock's elapsed and remaining text, stepped digit by digit as the clocks tick, and
+// the dashboard field each is shown in
+static ClockView clock_view;
+static const DashField clock_fields[CLOCK_FIELDS] = {
+  [CLOCK_DRIVE_TIME] = DASH_DRIVE_TIME,
+  [CLOCK_DRIVE_REMAINING] = DASH_DRIVE_REMAINING,
+  [CLOCK_REST_TIME] = DASH_REST_TIME,
+  [CLOCK_REST_REMAINING] = DASH_REST_REMAINING,
+};
+
+// One timer for both clocks, armed for the next moment the display or an alert changes
 static AppTimer* update_timer = NULL;
-static double start_time = 0;
-static double pause_time = 0;
+// Battery saving mode redraws on the system minute tick instead
+static bool minute_ticks = false;
+
+// duty_revision the projected times on screen were worked out for
+static uint32_t projected_revision = UINT32_MAX;
 
-// Keeping track of rest time
-static double rest_elapsed_time = 0;
-static bool rest_started = false;
-static AppTimer* update_rest_timer = NULL;
-static double rest_start_time = 0;
-static double pause_rest_time = 0;
+// Set while the background worker owns the duty state; the app then only shows it and
+// forwards button presses and settings to the worker
+static bool viewer = false;
 
 #define TIMER_UPDATE 1
-#define PERSIST_STATE 1
   
 #define BUTTON_REST BUTTON_ID_SELECT
 #define BUTTON_RUN BUTTON_ID_UP
 #define BUTTON_RESET BUTTON_ID_DOWN
   
 // Settings Keys
-#define KEY_BATTERY 0
-#define KEY_RULES 1
-bool battery_setting;
-bool rules_setting;
-  
-double float_time_ms() {
-	time_t seconds;
-	uint16_t milliseconds;
-	time_ms(&seconds, &milliseconds);
-	return (double)seconds + ((double)milliseconds / 1000.0);
-}
-	
-struct StopwatchState {
-	bool started;
-	double elapsed_time;
-	double start_time;
-	double pause_time;
-  bool rest_started;
-	double rest_elapsed_time;
-	double rest_start_time;
-	double pause_rest_time;
-  bool battery_setting;
-  bool rules_setting;
-} __attribute__((__packed__));
+#define KEY_SETTINGS 2
+
+// KEY_SETTINGS carries a byte array: the protocol version, a mask of the fields present, the
+// SETTING_ flag bits, the RulesId and the MotionMode to use. settings.js ships in the same
+// bundle, so only the current version is accepted.
+#define SETTINGS_PROTOCOL 2
+#define SETTINGS_VERSION 0
+#define SETTINGS_PRESENT 1
+#define SETTINGS_FLAGS 2
+#define SETTINGS_RULES 3
+#define SETTINGS_MOTION 4
+#define SETTINGS_LENGTH 5
+
+#define SETTING_BATTERY (1 << 0)
+#define SETTING_RULES (1 << 1)
+#define SETTING_MOTION (1 << 2)
 
 void config_provider(Window *window);
 void config_provider_reset(Window *reset_confirm);
 void handle_init();
+static void main_window_load(Window* window);
+static void main_window_unload(Window* window);
+static void reset_window_load(Window* reset_confirm);
+static void reset_window_unload(Window* dialog);
 time_t time_seconds();
-void stop_stopwatch();
-void start_stopwatch();
 void toggle_stopwatch_handler(ClickRecognizerRef recognizer, Window *window);
 void toggle_rest_stopwatch_handler(ClickRecognizerRef recognizer, Window *window);
+void toggle_work_handler(ClickRecognizerRef recognizer, Window *window);
+void switch_profile_handler(ClickRecognizerRef recognizer, Window *window);
 void reset_stopwatch_handler(ClickRecognizerRef recognizer, Window *window);
+void diagnostics_handler(ClickRecognizerRef recognizer, Window *window);
 void cancel_reset_handler(ClickRecognizerRef recognizer, Window *reset_confirm);
-void update_stopwatch();
-void update_rest_stopwatch();
+void schedule_wakeups();
+void send_to_worker(DutyMessage type, uint16_t data0, uint16_t data1, uint16_t data2);
+void notify_driver(uint8_t notify);
+void handle_worker_message(uint16_t type, AppWorkerMessage* message);
+static void take_back_from_worker();
+void handle_motion(uint8_t notify);
+void refresh_display(int64_t now);
+void refresh_clocks();
+void schedule_update();
 void handle_timer(void* data);
-void handle_rest_timer(void* data);
+void handle_minute_tick(struct tm* tick_time, TimeUnits units_changed);
 int main();
 
 static void in_recv_handler(DictionaryIterator *iterator, void *context) {
-  //Get Tuple
-  Tuple *t = dict_read_first(iterator);
-  if(t) {
-    switch(t->key) {
-    case KEY_BATTERY:
-      //It's the KEY_BATTERY key
-      if(strcmp(t->value->cstring, "off") == 0) {
-        //Set and save as battery save mode off
-        battery_setting = false;
-        update_stopwatch();
-        update_rest_stopwatch();
-      } else if(strcmp(t->value->cstring, "on") == 0) {
-        //Set and save as battery save mode on
-        battery_setting = true;
-        update_stopwatch();
-        update_rest_stopwatch();
-      }
-      break;
+  if(log_export_received(iterator)) {
+    return;
+  }
+
+  Tuple *t = dict_find(iterator, KEY_SETTINGS);
+  if(t == NULL || t->type != TUPLE_BYTE_ARRAY || t->length != SETTINGS_LENGTH
+      || t->value->data[SETTINGS_VERSION] != SETTINGS_PROTOCOL) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Ignored unrecognised settings message.");
+    return;
+  }
+  const uint8_t* settings = t->value->data;
+  uint8_t present = settings[SETTINGS_PRESENT];
+
+  // Only fields the phone marks as present are applied; the rest keep their current values
+  bool battery_setting = duty->battery_setting;
+  bool rules_setting = duty->rules_setting;
+  uint8_t motion_mode = duty_motion_mode;
+  if(present & SETTING_BATTERY) {
+    battery_setting = (settings[SETTINGS_FLAGS] & SETTING_BATTERY) != 0;
+  }
+  if(present & SETTING_RULES) {
+    if(settings[SETTINGS_RULES] >= RULES_COUNT) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Ignored unknown rule set %u.", settings[SETTINGS_RULES]);
+      return;
     }
+    rules_setting = settings[SETTINGS_RULES] == RULES_DOMESTIC;
   }
-  
-  Tuple *trules = dict_read_next(iterator);
-  if(trules) {
-    switch(trules->key) {
-      case KEY_RULES:
-      if(strcmp(trules->value->cstring, "driving") == 0) {
-        //Set and save as HGV mode
-        rules_setting = false;
-        update_stopwatch();
-        update_rest_stopwatch();
-      } else if(strcmp(trules->value->cstring, "domestic") == 0) {
-        //Set and save as domestic mode
-        rules_setting = true;
-        update_stopwatch();
-        update_rest_stopwatch();
-      }
-      break;
+  if(present & SETTING_MOTION) {
+    if(settings[SETTINGS_MOTION] >= MOTION_MODES) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Ignored unknown motion mode %u.", settings[SETTINGS_MOTION]);
+      return;
     }
+    motion_mode = settings[SETTINGS_MOTION];
+  }
+  if(battery_setting == duty->battery_setting && rules_setting == duty->rules_setting
+      && motion_mode == duty_motion_mode) {
+    return;
+  }
+
+  // Everything is applied in one go, followed by a single redraw
+  if(viewer) {
+    send_to_worker(DUTY_MSG_SETTINGS, battery_setting, rules_setting, motion_mode);
+    return;
   }
+  duty_apply_settings(battery_setting, rules_setting, motion_mode);
+  perf_set_mode(duty->battery_setting);
+  motion_feed_update(handle_motion);
+  refresh_clocks();
+  schedule_update();
 }
 
 void handle_init() {
+  int64_t started = epoch_ms();
   
-  // Receiving and loading settings data
+  // Receiving settings, a byte array of up to SETTINGS_LENGTH bytes, and export requests, a
+  // four-byte integer, one tuple at a time; and sending the duty log a block at a time
   app_message_register_inbox_received((AppMessageInboxReceived) in_recv_handler);
-  app_message_open(app_message_inbox_size_maximum(), app_message_outbox_size_maximum());
-  
-	window = window_create();
-  window_stack_push(window, true);
-  window_set_background_color(window, GColorBlack);
-  window_set_fullscreen(window, false);
-
-  // Get our fonts
-  large_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_ROBOTO_LIGHT_34));
-  small_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_ROBOTO_LIGHT_22));
-  label_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_ROBOTO_LIGHT_12));
-
-  // Root layer
-  Layer *root_layer = window_get_root_layer(window);
-
-  // Set up drive time label
-  drive_time_label_layer = text_layer_create(GRect(4, 2, 124, 12));
-  text_layer_set_background_color(drive_time_label_layer, GColorClear);
-  text_layer_set_font(drive_time_label_layer, label_font);
-  text_layer_set_text_color(drive_time_label_layer, GColorWhite);
-  text_layer_set_text(drive_time_label_layer, "Drive time");
-  text_layer_set_text_alignment(drive_time_label_layer, GTextAlignmentLeft);
-  layer_add_child(root_layer, (Layer*)drive_time_label_layer);
-  
-  // Set up the big timer.
-  big_time_layer = text_layer_create(GRect(4, 8, 124, 34));
-  text_layer_set_background_color(big_time_layer, GColorClear);
-  text_layer_set_font(big_time_layer, large_font);
-  text_layer_set_text_color(big_time_layer, GColorWhite);
-  if(battery_setting == true) {
-    text_layer_set_text(big_time_layer, "0:00");
-  } else {
-    text_layer_set_text(big_time_layer, "0:00:00");
+  app_message_open(dict_calc_buffer_size(1, SETTINGS_LENGTH), log_export_outbox_size());
+
+  // Alerts are back on the update timer or the worker while the app is open
+  wakeup_cancel_all();
+  if(launch_reason() == APP_LAUNCH_WAKEUP) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Launched by a wakeup for an alert.");
+  } else if(launch_reason() == APP_LAUNCH_WORKER) {
+    // The worker cannot vibrate, so it opens the app to do it, leaving word of what for
+    notify_driver(persist_read_int(PERSIST_LAUNCH_NOTIFY));
   }
-  text_layer_set_text_alignment(big_time_layer, GTextAlignmentLeft);
-  layer_add_child(root_layer, (Layer*)big_time_layer);
-  
-  // Set up drive remaining label
-  drive_remaining_label_layer = text_layer_create(GRect(4, 43, 124, 15));
-  text_layer_set_background_color(drive_remaining_label_layer, GColorClear);
-  text_layer_set_font(drive_remaining_label_layer, label_font);
-  text_layer_set_text_color(drive_remaining_label_layer, GColorWhite);
-  text_layer_set_text(drive_remaining_label_layer, "Remaining");
-  text_layer_set_text_alignment(drive_remaining_label_layer, GTextAlignmentLeft);
-  layer_add_child(root_layer, (Layer*)drive_remaining_label_layer);
-  
-  // Set up remaining drive time layer
-  remaining_drive_layer = text_layer_create(GRect(4, 53, 124, 22));
-  text_layer_set_background_color(remaining_drive_layer, GColorClear);
-  text_layer_set_font(remaining_drive_layer, small_font);
-  text_layer_set_text_color(remaining_drive_layer, GColorWhite);
-  if(battery_setting == true) {
-    text_layer_set_text(remaining_drive_layer, "4:30");
-  } else {
-    text_layer_set_text(remaining_drive_layer, "4:30:00");
+  if(persist_exists(PERSIST_LAUNCH_NOTIFY)) {
+    persist_delete(PERSIST_LAUNCH_NOTIFY);
   }
-  text_layer_set_text_alignment(remaining_drive_layer, GTextAlignmentLeft);
-  layer_add_child(root_layer, (Layer*)remaining_drive_layer);
-  
-  // Set up rest time label
-  rest_time_label_layer = text_layer_create(GRect(4, 75, 124, 12));
-  text_layer_set_background_color(rest_time_label_layer, GColorClear);
-  text_layer_set_font(rest_time_label_layer, label_font);
-  text_layer_set_text_color(rest_time_label_layer, GColorWhite);
-  text_layer_set_text(rest_time_label_layer, "Rest time");
-  text_layer_set_text_alignment(rest_time_label_layer, GTextAlignmentLeft);
-  layer_add_child(root_layer, (Layer*)rest_time_label_layer);
-  
-  // Set up the rest timer.
-  big_rest_layer = text_layer_create(GRect(4, 81, 124, 34));
-  text_layer_set_background_color(big_rest_layer, GColorClear);
-  text_layer_set_font(big_rest_layer, large_font);
-  text_layer_set_text_color(big_rest_layer, GColorWhite);
-  if(battery_setting == true) {
-    text_layer_set_text(big_rest_layer, "00");
+
+  perf_load();
+  bool loaded;
+  if(app_worker_is_running()) {
+    viewer = true;
+    app_worker_message_subscribe(handle_worker_message);
+    loaded = duty_load();
+    if(duty_idle()) {
+      take_back_from_worker();
+    }
   } else {
-    text_layer_set_text(big_rest_layer, "00:00");
+    loaded = duty_init();
+    motion_feed_update(handle_motion);
   }
-  text_layer_set_text_alignment(big_rest_layer, GTextAlignmentLeft);
-  layer_add_child(root_layer, (Layer*)big_rest_layer);
-  
-  // Set up rest remaining label
-  rest_remaining_label_layer = text_layer_create(GRect(4, 115, 124, 15));
-  text_layer_set_background_color(rest_remaining_label_layer, GColorClear);
-  text_layer_set_font(rest_remaining_label_layer, label_font);
-  text_layer_set_text_color(rest_remaining_label_layer, GColorWhite);
-  text_layer_set_text(rest_remaining_label_layer, "Remaining");
-  text_layer_set_text_alignment(rest_remaining_label_layer, GTextAlignmentLeft);
-  layer_add_child(root_layer, (Layer*)rest_remaining_label_layer);
-  
-  // Set up remaining rest time layer
-  remaining_rest_layer = text_layer_create(GRect(4, 125, 124, 22));
-  text_layer_set_background_color(remaining_rest_layer, GColorClear);
-  text_layer_set_font(remaining_rest_layer, small_font);
-  text_layer_set_text_color(remaining_rest_layer, GColorWhite);
-  if(battery_setting == true) {
-    text_layer_set_text(remaining_rest_layer, "45");
-  } else {
-    text_layer_set_text(remaining_rest_layer, "45:00");
+  perf_set_mode(duty->battery_setting);
+
+  // The window is built once the state is loaded, so its first frame shows the real clocks
+  // in the format and rule set the settings ask for
+	window = window_create();
+  window_set_window_handlers(window, (WindowHandlers) {
+    .load = main_window_load,
+    .unload = main_window_unload,
+  });
+  window_set_background_color(window, GColorBlack);
+  window_set_fullscreen(window, false);
+  window_stack_push(window, true);
+  refresh_clocks();
+
+  if(loaded) {
+		if(duty->drive.running || duty->rest.running) {
+			schedule_update();
+			APP_LOG(APP_LOG_LEVEL_DEBUG, "Started timer to resume persisted state.");
+		}
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Loaded persisted state.");
   }
-  text_layer_set_text_alignment(remaining_rest_layer, GTextAlignmentLeft);
-  layer_add_child(root_layer, (Layer*)remaining_rest_layer);
-  
+
+  // Launch cost, to keep an eye on what init builds up front
+  APP_LOG(APP_LOG_LEVEL_INFO, "Started in %ld ms with %u bytes of heap in use.",
+          (long)(epoch_ms() - started), (unsigned)heap_bytes_used());
+}
+
+// Build the main display; the glyph atlas and bitmaps live exactly as long as the window is
+// loaded
+static void main_window_load(Window* window) {
+  projected_revision = UINT32_MAX;
+
+  // Both clocks and their labels are drawn by one layer
+  dashboard_create(window_get_root_layer(window));
+  clock_view_init(&clock_view);
   // Initialize the action bar:
   action_bar = action_bar_layer_create();
   // Associate the action bar with the window:
@@ -279,43 +259,26 @@ void handle_init() {
   action_bar_layer_set_icon(action_bar, BUTTON_ID_SELECT, rest_button);
   reset_button = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_RESET_BUTTON);
   action_bar_layer_set_icon(action_bar, BUTTON_ID_DOWN, reset_button);
-  
-	struct StopwatchState state;
-  if(persist_read_data(PERSIST_STATE, &state, sizeof(state)) != E_DOES_NOT_EXIST) {
-		started = state.started;
-		start_time = state.start_time;
-		elapsed_time = state.elapsed_time;
-		pause_time = state.pause_time;
-    rest_started = state.rest_started;
-		rest_start_time = state.rest_start_time;
-		rest_elapsed_time = state.rest_elapsed_time;
-		pause_rest_time = state.pause_rest_time;
-    battery_setting = state.battery_setting;
-    rules_setting = state.rules_setting;
-    update_stopwatch();
-		update_rest_stopwatch();
-		if(started) {
-			update_timer = app_timer_register(100, handle_timer, NULL);
-			APP_LOG(APP_LOG_LEVEL_DEBUG, "Started timer to resume persisted state.");
-		}
-    if(rest_started) {
-			update_rest_timer = app_timer_register(100, handle_rest_timer, NULL);
-			APP_LOG(APP_LOG_LEVEL_DEBUG, "Started timer to resume persisted state.");
-		}
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "Loaded persisted state.");
-  }
-  
-  // Reset confirmation window
-  reset_confirm = window_create();
-  window_set_background_color(reset_confirm, GColorBlack);
-  
+}
+
+static void main_window_unload(Window* window) {
+  action_bar_layer_destroy(action_bar);
+  gbitmap_destroy(drive_button);
+  gbitmap_destroy(rest_button);
+  gbitmap_destroy(reset_button);
+  dashboard_destroy();
+}
+
+// The reset dialog is rarely seen, so it is only built while it is on screen
+static void reset_window_load(Window* reset_confirm) {
   // Root layer
   Layer *root_layer_reset = window_get_root_layer(reset_confirm);
+  reset_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_ROBOTO_LIGHT_22));
   
   // Set up reset warning label
   reset_warning_label_layer = text_layer_create(GRect(4, 48, 124, 100));
   text_layer_set_background_color(reset_warning_label_layer, GColorClear);
-  text_layer_set_font(reset_warning_label_layer, small_font);
+  text_layer_set_font(reset_warning_label_layer, reset_font);
   text_layer_set_text_color(reset_warning_label_layer, GColorWhite);
   text_layer_set_text(reset_warning_label_layer, "Reset all timers?");
   text_layer_set_text_alignment(reset_warning_label_layer, GTextAlignmentLeft);
@@ -335,172 +298,162 @@ void handle_init() {
   action_bar_layer_set_icon(action_bar_reset, BUTTON_ID_DOWN, reset_button);
 }
 
-void handle_deinit() {
-	struct StopwatchState state = (struct StopwatchState){
-		.started = started,
-		.start_time = start_time,
-		.elapsed_time = elapsed_time,
-		.pause_time = pause_time,
-    .rest_started = rest_started,
-		.rest_start_time = rest_start_time,
-		.rest_elapsed_time = rest_elapsed_time,
-		.pause_rest_time = pause_rest_time,
-    .battery_setting = battery_setting,
-    .rules_setting = rules_setting,
-	};
-	status_t status = persist_write_data(PERSIST_STATE, &state, sizeof(state));
-	if(status < S_SUCCESS) {
-		APP_LOG(APP_LOG_LEVEL_WARNING, "Failed to persist state: %ld", status);
-	}
-	if(status < S_SUCCESS) {
-		APP_LOG(APP_LOG_LEVEL_WARNING, "Failed to persist laps: %ld", status);
-	}
-	
-  // Main window
-  action_bar_layer_destroy(action_bar);
-  gbitmap_destroy(drive_button);
-  gbitmap_destroy(rest_button);
-  gbitmap_destroy(reset_button);
-	text_layer_destroy(big_time_layer);
-  text_layer_destroy(remaining_drive_layer);
-  text_layer_destroy(big_rest_layer);
-  text_layer_destroy(remaining_rest_layer);
-	fonts_unload_custom_font(large_font);
-  fonts_unload_custom_font(small_font);
-	window_destroy(window);
-  
-  // Reset window
+static void reset_window_unload(Window* dialog) {
   action_bar_layer_destroy(action_bar_reset);
-  window_destroy(reset_confirm);
+  text_layer_destroy(reset_warning_label_layer);
+  fonts_unload_custom_font(reset_font);
+  gbitmap_destroy(confirm_button);
+  window_destroy(dialog);
+  reset_confirm = NULL;
 }
 
-void stop_stopwatch() {
-  started = false;
-	pause_time = float_time_ms();
-  if(update_timer != NULL) {
-    app_timer_cancel(update_timer);
-    update_timer = NULL;
+
+// Leave timekeeping to the worker once the app closes, falling back to the system wakeup
+// service if it cannot be started
+static void hand_over_to_worker() {
+  if(duty_idle()) {
+    return;
+  }
+  AppWorkerResult result = app_worker_launch();
+  if(result != APP_WORKER_RESULT_SUCCESS && result != APP_WORKER_RESULT_ALREADY_RUNNING) {
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Worker not started (%d), using wakeups.", (int)result);
+    schedule_wakeups();
   }
 }
 
-void stop_rest_stopwatch() {
-  rest_started = false;
-	pause_rest_time = float_time_ms();
-  if(update_rest_timer != NULL) {
-    app_timer_cancel(update_rest_timer);
-    update_rest_timer = NULL;
+void handle_deinit() {
+  log_export_deinit();
+
+  // A viewer never writes; the worker has everything already
+  if(!viewer) {
+    motion_feed_stop();
+    duty_deinit();
+    hand_over_to_worker();
   }
-}
+  perf_report();
+  perf_save();
 
-void start_stopwatch() {
-  started = true;
-  if(start_time == 0) {
-		start_time = float_time_ms();
-	} else if(pause_time != 0) {
-		double interval = float_time_ms() - pause_time;
-		start_time += interval;
-	}
-  update_timer = app_timer_register(100, handle_timer, NULL);
+  // Everything else belongs to the window and goes with its unload
+	window_destroy(window);
 }
 
-void start_rest_stopwatch() {
-  rest_started = true;
-  if(rest_start_time == 0) {
-		rest_start_time = float_time_ms();
-	} else if(pause_rest_time != 0) {
-		double rest_interval = float_time_ms() - pause_rest_time;
-		rest_start_time += rest_interval;
-	}
-  update_rest_timer = app_timer_register(100, handle_rest_timer, NULL);
+void send_to_worker(DutyMessage type, uint16_t data0, uint16_t data1, uint16_t data2) {
+  AppWorkerMessage message = { .data0 = data0, .data1 = data1, .data2 = data2 };
+  app_worker_send_message(type, &message);
 }
 
-void toggle_stopwatch_handler(ClickRecognizerRef recognizer, Window *window) {
-  if(started) {
-    stop_stopwatch();
-  } else {
-    start_stopwatch();
+// Tell the driver about whatever a state change raised
+void notify_driver(uint8_t notify) {
+  switch(duty_vibe(notify)) {
+    case DUTY_VIBE_DOUBLE:
+      vibes_double_pulse();
+      break;
+    case DUTY_VIBE_SHORT:
+      vibes_short_pulse();
+      break;
+    case DUTY_VIBE_LONG:
+      vibes_long_pulse();
+      break;
+    default:
+      break;
   }
-  if(rest_started) {
-    stop_rest_stopwatch();
+}
+
+// The motion detector saw the cab start or stop
+void handle_motion(uint8_t notify) {
+  notify_driver(notify);
+  refresh_clocks();
+  schedule_update();
+}
+
+// With every clock stopped and motion detection off the worker has nothing left to do, and
+// Pebble only runs one at a time, so stop it and own the state again. It flushed the log
+// before reporting the idle state, so the app picks up from flash where it left off.
+static void take_back_from_worker() {
+  app_worker_message_unsubscribe();
+  app_worker_kill();
+  viewer = false;
+  duty_init();
+  motion_feed_update(handle_motion);
+}
+
+// The worker saved a change; show it
+void handle_worker_message(uint16_t type, AppWorkerMessage* message) {
+  if(type != DUTY_MSG_CHANGED) {
+    return;
   }
-  if(rules_setting == true) {
-    if(rest_elapsed_time < 1800) {
-      rest_start_time = 0;
-      rest_elapsed_time = 0;
-      update_rest_stopwatch();
-    }
-  } else {
-    if(rest_elapsed_time < 900) {
-      rest_start_time = 0;
-      rest_elapsed_time = 0;
-      update_rest_stopwatch();
-    }
-    if(rest_elapsed_time >= 900 ) {
-      if(rest_elapsed_time <= 2700) {
-        double rest_now = float_time_ms();
-        rest_start_time = rest_now - 900;
-        rest_elapsed_time = 900;
-        update_rest_stopwatch();
-      }
-    }
+  duty_load();
+  if(duty_idle()) {
+    take_back_from_worker();
   }
-  if(rules_setting == true) {
-    if(rest_elapsed_time >= 1800) {
-      bool is_running = started;
-      bool rest_is_running = rest_started;
-      start_time = 0;
-      rest_start_time = 0;
-      elapsed_time = 0;
-      rest_elapsed_time = 0;
-      if(is_running) stop_stopwatch();
-      if(rest_is_running) stop_rest_stopwatch();
-      update_stopwatch();
-      update_rest_stopwatch();
-      start_stopwatch();
-    }
-  } else {
-    if(rest_elapsed_time >= 2700) {
-      bool is_running = started;
-      bool rest_is_running = rest_started;
-      start_time = 0;
-      rest_start_time = 0;
-      elapsed_time = 0;
-      rest_elapsed_time = 0;
-      if(is_running) stop_stopwatch();
-      if(rest_is_running) stop_rest_stopwatch();
-      update_stopwatch();
-      update_rest_stopwatch();
-      start_stopwatch();
-    }
+  perf_set_mode(duty->battery_setting);
+  notify_driver(message->data0);
+  refresh_clocks();
+  schedule_update();
+}
+
+// Every button that changes activity goes through the duty engine's transition table
+static void press(DutyPress press) {
+  if(viewer) {
+    send_to_worker(DUTY_MSG_PRESS, press, 0, 0);
+    return;
   }
+  notify_driver(duty_press(press));
+  refresh_clocks();
+  schedule_update();
+}
+
+void toggle_stopwatch_handler(ClickRecognizerRef recognizer, Window *window) {
+  press(DUTY_PRESS_DRIVE);
 }
 
 void toggle_rest_stopwatch_handler(ClickRecognizerRef recognizer, Window *window) {
-  if(rest_started) {
-    stop_rest_stopwatch();
-  } else {
-    start_rest_stopwatch();
-  }
-  if(started) {
-    stop_stopwatch();
+  press(DUTY_PRESS_REST);
+}
+
+// Holding drive steps through other work and availability
+void toggle_work_handler(ClickRecognizerRef recognizer, Window *window) {
+  press(DUTY_PRESS_WORK);
+}
+
+// Holding rest moves on to the next driver's clocks
+void switch_profile_handler(ClickRecognizerRef recognizer, Window *window) {
+  uint8_t profile = (duty_profile + 1) % DUTY_PROFILES;
+  if(viewer) {
+    send_to_worker(DUTY_MSG_SWITCH_PROFILE, profile, 0, 0);
+    return;
   }
+  notify_driver(duty_switch_profile(profile));
+  refresh_clocks();
+  schedule_update();
 }
 
 void reset_stopwatch_handler(ClickRecognizerRef recognizer, Window *window) {
+  if(reset_confirm != NULL) {
+    return;
+  }
+  reset_confirm = window_create();
+  window_set_window_handlers(reset_confirm, (WindowHandlers) {
+    .load = reset_window_load,
+    .unload = reset_window_unload,
+  });
+  window_set_background_color(reset_confirm, GColorBlack);
   window_stack_push(reset_confirm, true);
 }
 
+// Holding reset opens the diagnostics view
+void diagnostics_handler(ClickRecognizerRef recognizer, Window *window) {
+  diagnostics_show();
+}
+
 void accept_reset_handler(ClickRecognizerRef recognizer, Window *reset_confirm) {
-  bool is_running = started;
-  bool rest_is_running = rest_started;
-  start_time = 0;
-  rest_start_time = 0;
-  elapsed_time = 0;
-  rest_elapsed_time = 0;
-  if(is_running) stop_stopwatch();
-  if(rest_is_running) stop_rest_stopwatch();
-  update_stopwatch();
-  update_rest_stopwatch();
+  if(viewer) {
+    send_to_worker(DUTY_MSG_RESET, 0, 0, 0);
+  } else {
+    duty_reset();
+    refresh_clocks();
+    schedule_update();
+  }
   window_stack_pop(true);
 }
 
@@ -508,143 +461,139 @@ void cancel_reset_handler(ClickRecognizerRef recognizer, Window *reset_confirm)
   window_stack_pop(true);
 }
 
-// Update timer display
-void update_stopwatch() {
-  
-  static char big_time[] = "0:00:00";
-  static char remaining_drive[] = "0:00:00";
-  
-  int drive_seconds;
-  if(rules_setting == true) {
-    drive_seconds = 19800;
-  } else {
-    drive_seconds = 16200;
+// Arm the update timer for the nearest display rollover or alert across both clocks. In
+// battery saving mode the display follows the minute tick and the timer is only a one-shot
+// alarm for the next warning.
+void schedule_update() {
+  if(update_timer != NULL) {
+    app_timer_cancel(update_timer);
+    update_timer = NULL;
   }
 
-  // Now convert to hours/minutes/seconds.
-  int seconds = (int)elapsed_time % 60;
-  int minutes = (int)elapsed_time / 60 % 60;
-  int hours = (int)elapsed_time / 3600;
-  int rSeconds = (drive_seconds - (int)elapsed_time) % 60;
-  int rMinutes = (drive_seconds - (int)elapsed_time) / 60 % 60;
-  int rHours = (drive_seconds - (int)elapsed_time) / 3600;
-  
-  // When one hour of driving time remains, alert user with a short pulse
-  if((int)elapsed_time == (drive_seconds - 3600)) {
-    vibes_short_pulse();
-    return;
+  bool want_ticks = clock_view_minute_ticks();
+  if(want_ticks != minute_ticks) {
+    if(want_ticks) {
+      tick_timer_service_subscribe(MINUTE_UNIT, handle_minute_tick);
+    } else {
+      tick_timer_service_unsubscribe();
+    }
+    minute_ticks = want_ticks;
   }
-  
-  // When thirty minutes of driving time remain, alert user with a short pulse
-  if((int)elapsed_time == (drive_seconds - 1800)) {
-    vibes_short_pulse();
-    return;
+  int32_t wait = clock_view_next_update();
+  if(wait >= 0) {
+    update_timer = app_timer_register(wait, handle_timer, NULL);
   }
+}
 
-  // When driver time runs out, stop timer and alert user with a short pulse
-  if((int)elapsed_time == (drive_seconds - 1)) {
-    vibes_short_pulse();
+// Arm a wakeup for each deadline still ahead of a running clock
+static void schedule_clock_wakeups(const DutyClock* clock, const DeadlineList* deadlines, int32_t handled, int64_t now) {
+  if(!clock->running) {
     return;
   }
-  
-  if((int)elapsed_time > drive_seconds) {
-    stop_stopwatch();
-    return;
-  }
-
-  // Create string from timer and remaining time for display
-  if(battery_setting == true) {
-    snprintf(big_time, 9, "%d:%02d", hours, minutes);
-    snprintf(remaining_drive, 9, "%d:%02d", rHours, rMinutes);
-  } else {
-    snprintf(big_time, 9, "%d:%02d:%02d", hours, minutes, seconds);
-    snprintf(remaining_drive, 9, "%d:%02d:%02d", rHours, rMinutes, rSeconds);
+  int32_t elapsed = clock_elapsed(clock, now);
+  for(uint8_t i = 0; i < deadlines->count; i++) {
+    const Deadline* deadline = &deadlines->items[i];
+    if(deadline->at <= handled || deadline->at * 1000 <= elapsed) {
+      continue;
+    }
+    time_t when = (now + deadline->at * 1000 - elapsed + 999) / 1000;
+    WakeupId id = wakeup_schedule(when, deadline->action, true);
+    if(id < 0) {
+      // Wakeups less than a minute apart are refused; the earlier one relaunches us in time
+      // to arm the rest
+      APP_LOG(APP_LOG_LEVEL_DEBUG, "Skipped wakeup at %ld: %ld", (long)when, (long)id);
+    }
   }
+}
 
-  // Now draw the strings.
-  text_layer_set_text(big_time_layer, big_time);
-  text_layer_set_text(remaining_drive_layer, remaining_drive);
+// While the app is closed without a worker, the system wakeup service stands in for the
+// update timer so alerts still land on time without anything polling
+void schedule_wakeups() {
+  wakeup_cancel_all();
+  int64_t now = epoch_ms();
+  schedule_clock_wakeups(&duty->drive, &duty_drive_deadlines, duty->drive_alarmed, now);
+  schedule_clock_wakeups(&duty->rest, &duty_rest_deadlines, duty->rest_alarmed, now);
 }
 
-// Update rest display
-void update_rest_stopwatch() {
-  
-  static char rest_time[] = "00:00";
-  static char remaining_rest[] = "00:00";
-  
-  int rest_total_seconds;
-  if(rules_setting == true) {
-    rest_total_seconds = 1800;
-  } else {
-    rest_total_seconds = 2700;
+// Show a projected time of day, or nothing if there is none
+static void show_projection(DashField field, const char* prefix, time_t when) {
+  char text[12] = "";
+  if(when != 0) {
+    size_t length = strlen(prefix);
+    memcpy(text, prefix, length);
+    strftime(text + length, sizeof(text) - length, clock_is_24h_style() ? "%H:%M" : "%I:%M",
+             localtime(&when));
   }
+  dashboard_set_text(field, text);
+}
 
-  // Now convert to hours/minutes/seconds.
-  int rest_seconds = (int)rest_elapsed_time % 60;
-  int rest_minutes = (int)rest_elapsed_time / 60 % 60;
-  int rest_rSeconds = (rest_total_seconds - (int)rest_elapsed_time) % 60;
-  int rest_rMinutes = (rest_total_seconds - (int)rest_elapsed_time) / 60 % 60;
-  
-  // When fifteen minutes of rest time has passed, alert user with a short pulse
-  if(rules_setting == false) {
-    if((int)rest_elapsed_time == 899) {
-      vibes_short_pulse();
-      return;
-    }
-  }
-  
-  // When rest time is completed, stop timer, alert user with a short pulse and reset drive timer
-  if((int)rest_elapsed_time == (rest_total_seconds - 1)) {
-    vibes_short_pulse();
-    return;
-  }
-  
-  if((int)rest_elapsed_time > rest_total_seconds) {
-    stop_rest_stopwatch();
-    start_time = 0;
-    elapsed_time = 0;
-    update_stopwatch();
+// Wall-clock times only move when the state does, so they are worked out and formatted once
+// per transition and left alone on every other tick
+static void update_projection() {
+  if(projected_revision == duty_revision) {
     return;
   }
+  projected_revision = duty_revision;
+  Projection projection;
+  projection_compute(time(NULL), &projection);
+  show_projection(DASH_DAY_LIMIT, "day ", projection.day_limit);
+  show_projection(DASH_BREAK_DUE, "break ", projection.break_due);
+  show_projection(DASH_REST_COMPLETE, "done ", projection.rest_complete);
+
+  char profile[12] = "driver 1";
+  profile[7] += duty_profile;
+  dashboard_set_text(DASH_PROFILE, profile);
+
+  // The clocks show driving and rest; other duty is named on the top row instead
+  static const char* activities[DUTY_ACTIVITIES] = {
+    [DUTY_OTHER_WORK] = "other work",
+    [DUTY_AVAILABLE] = "available",
+  };
+  const char* activity = activities[duty->activity];
+  dashboard_set_text(DASH_ACTIVITY, activity != NULL ? activity : "");
+}
 
-  // Create string from timer and remaining time for display
-  if(battery_setting == true) {
-    snprintf(rest_time, 9, "%02d", rest_minutes);
-    snprintf(remaining_rest, 9, "%02d", rest_rMinutes);
-  } else {
-    snprintf(rest_time, 9, "%02d:%02d", rest_minutes, rest_seconds);
-    snprintf(remaining_rest, 9, "%02d:%02d", rest_rMinutes, rest_rSeconds);
+// One pass over both clocks; the dashboard only redraws if some text changed
+void refresh_display(int64_t now) {
+  uint8_t changed = clock_view_render(&clock_view, now);
+  for(uint8_t i = 0; i < CLOCK_FIELDS; i++) {
+    if(changed & (1 << i)) {
+      dashboard_set_text(clock_fields[i], clock_view.text[i].text);
+    }
   }
+  update_projection();
+}
 
-  // Now draw the strings.
-  text_layer_set_text(big_rest_layer, rest_time);
-  text_layer_set_text(remaining_rest_layer, remaining_rest);
+// Act on passed deadlines unless the worker does, then bring both clocks up to date and
+// redraw
+void refresh_clocks() {
+  if(!viewer) {
+    notify_driver(duty_advance());
+  }
+  refresh_display(epoch_ms());
 }
 
 void handle_timer(void* data) {
-	if(started) {
-		double now = float_time_ms();
-		elapsed_time = now - start_time;
-		update_timer = app_timer_register(100, handle_timer, NULL);
-	}
-	update_stopwatch();
-  update_rest_stopwatch();
+  perf_handler_begin();
+  update_timer = NULL;
+  refresh_clocks();
+  schedule_update();
+  perf_handler_end();
 }
 
-void handle_rest_timer(void* data) {
-	if(rest_started) {
-		double rest_now = float_time_ms();
-		rest_elapsed_time = rest_now - rest_start_time;
-		update_rest_timer = app_timer_register(100, handle_rest_timer, NULL);
-	}
-	update_rest_stopwatch();
-  update_stopwatch();
+void handle_minute_tick(struct tm* tick_time, TimeUnits units_changed) {
+  perf_handler_begin();
+  refresh_clocks();
+  perf_handler_end();
 }
 
 void config_provider(Window *window) {
 	window_single_click_subscribe(BUTTON_RUN, (ClickHandler)toggle_stopwatch_handler);
 	window_single_click_subscribe(BUTTON_RESET, (ClickHandler)reset_stopwatch_handler);
 	window_single_click_subscribe(BUTTON_REST, (ClickHandler)toggle_rest_stopwatch_handler);
+	window_long_click_subscribe(BUTTON_RUN, 500, (ClickHandler)toggle_work_handler, NULL);
+	window_long_click_subscribe(BUTTON_REST, 500, (ClickHandler)switch_profile_handler, NULL);
+	window_long_click_subscribe(BUTTON_RESET, 500, (ClickHandler)diagnostics_handler, NULL);
 }
 
 void config_provider_reset(Window *reset_confirm) {
@@ -657,4 +606,4 @@ int main() {
 	app_event_loop();
 	handle_deinit();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,67 @@
+// Times one display tick's worth of text, the drive clock and drive remaining in H:MM:SS and
+// the rest clock and rest remaining in MM:SS, through snprintf as the app used to and through
+// duration_render. Each pass ticks through a whole 15 hour shift a second at a time.
+
+#include <stdlib.h>
+#include <time.h>
+#include "printf_duration.h"
+
+#define SHIFT_SECONDS (15 * 3600)
+#define DRIVE_LIMIT (9 * 3600)
+#define REST_LIMIT (45 * 60)
+#define PASSES 100
+
+static double now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Touch every text so neither loop can be optimised away
+static uint32_t sink;
+
+static double time_printf() {
+  char text[4][DURATION_TEXT_SIZE];
+  double start = now_ns();
+  for(int pass = 0; pass < PASSES; pass++) {
+    for(int32_t t = 0; t < SHIFT_SECONDS; t++) {
+      int32_t rest = t % 3600;
+      printf_duration(text[0], sizeof(text[0]), t, DURATION_H_MM_SS);
+      printf_duration(text[1], sizeof(text[1]), DRIVE_LIMIT - t, DURATION_H_MM_SS);
+      printf_duration(text[2], sizeof(text[2]), rest, DURATION_MM_SS);
+      printf_duration(text[3], sizeof(text[3]), REST_LIMIT - rest, DURATION_MM_SS);
+      sink += text[0][0] + text[1][1] + text[2][2] + text[3][3];
+    }
+  }
+  return (now_ns() - start) / ((double)PASSES * SHIFT_SECONDS);
+}
+
+static double time_render() {
+  DurationText text[4];
+  double start = now_ns();
+  for(int pass = 0; pass < PASSES; pass++) {
+    for(int i = 0; i < 4; i++) {
+      duration_init(&text[i]);
+    }
+    for(int32_t t = 0; t < SHIFT_SECONDS; t++) {
+      int32_t rest = t % 3600;
+      duration_render(&text[0], t, DURATION_H_MM_SS);
+      duration_render(&text[1], DRIVE_LIMIT - t, DURATION_H_MM_SS);
+      duration_render(&text[2], rest, DURATION_MM_SS);
+      duration_render(&text[3], REST_LIMIT - rest, DURATION_MM_SS);
+      sink += text[0].text[0] + text[1].text[1] + text[2].text[2] + text[3].text[3];
+    }
+  }
+  return (now_ns() - start) / ((double)PASSES * SHIFT_SECONDS);
+}
+
+int main() {
+  double printf_ns = time_printf();
+  double render_ns = time_render();
+  printf("bench_duration: %d ticks, four fields each\n", PASSES * SHIFT_SECONDS);
+  printf("  %-16s %8s\n", "path", "ns/tick");
+  printf("  %-16s %8.1f\n", "snprintf", printf_ns);
+  printf("  %-16s %8.1f\n", "duration_render", render_ns);
+  printf("  %-16s %7.1fx\n", "speedup", printf_ns / render_ns);
+  return sink == 0xFFFFFFFF;
+}
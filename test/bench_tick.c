@@ -0,0 +1,104 @@
+// Runs the 15 hour shift from test_shift through the duty engine in normal and battery saving
+// mode and prints what each costs: host CPU time per wakeup, the app's wakeups, the engine's
+// own timers and redraws per hour of the shift, and the flash writes over the whole of it.
+// The counts come from the perf counters perf_report logs on the watch, so the two can be
+// set side by side; only the CPU time is the host's own.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sim.h"
+#include "perf.h"
+
+#define RUNS 20
+#define SHIFT_HOURS 15
+
+typedef struct {
+  int hours, minutes;
+  DutyPress press;
+} Press;
+
+static const Press presses[] = {
+  { 6, 0, DUTY_PRESS_WORK },
+  { 6, 15, DUTY_PRESS_DRIVE },
+  { 10, 0, DUTY_PRESS_REST },
+  { 10, 15, DUTY_PRESS_DRIVE },
+  { 11, 0, DUTY_PRESS_REST },
+  { 11, 35, DUTY_PRESS_DRIVE },
+  { 15, 30, DUTY_PRESS_REST },
+  { 16, 30, DUTY_PRESS_WORK },
+  { 18, 0, DUTY_PRESS_DRIVE },
+  { 20, 0, DUTY_PRESS_WORK },
+  { 21, 0, DUTY_PRESS_WORK },
+};
+
+typedef struct {
+  double ns_per_wakeup;
+  uint32_t wakeups;
+  uint32_t engine_timers;
+  uint32_t redraws;
+  uint32_t writes;
+  uint32_t bytes;
+} Cost;
+
+static double cpu_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// The counters are the same every run, so only the time is averaged
+static Cost run_shift(bool battery) {
+  Cost cost = { 0 };
+  double spent = 0;
+  for(int run = 0; run < RUNS; run++) {
+    Sim sim;
+    sim_start(&sim, sim_time(6, 0, 0), battery, false);
+    uint32_t timers = host_timers_registered();
+    double start = cpu_ns();
+    for(size_t i = 0; i < ARRAY_LENGTH(presses); i++) {
+      sim_run_until(&sim, sim_time(presses[i].hours, presses[i].minutes, 0));
+      sim_press(&sim, presses[i].press);
+    }
+    spent += cpu_ns() - start;
+    sim_stop(&sim);
+
+    PerfMode modes[PERF_MODES];
+    perf_get(modes);
+    const PerfMode* mode = &modes[battery ? 1 : 0];
+    cost.wakeups = mode->counters[PERF_WAKEUP];
+    cost.redraws = mode->counters[PERF_REDRAW];
+    cost.writes = mode->counters[PERF_PERSIST_WRITE];
+    cost.bytes = mode->counters[PERF_PERSIST_BYTES];
+    cost.engine_timers = host_timers_registered() - timers;
+  }
+  cost.ns_per_wakeup = cost.wakeups > 0 ? spent / RUNS / cost.wakeups : 0;
+  return cost;
+}
+
+static void print_row(const char* name, const Cost* cost) {
+  printf("  %-8s %8.0f %8.1f %8.1f %8.1f %7lu %7lu\n", name, cost->ns_per_wakeup,
+         (double)cost->wakeups / SHIFT_HOURS, (double)cost->engine_timers / SHIFT_HOURS,
+         (double)cost->redraws / SHIFT_HOURS, (unsigned long)cost->writes,
+         (unsigned long)cost->bytes);
+}
+
+static double ratio(double normal, double battery) {
+  return battery > 0 ? normal / battery : 0;
+}
+
+int main() {
+  setenv("TZ", "UTC", 1);
+  Cost normal = run_shift(false);
+  Cost battery = run_shift(true);
+  printf("bench_tick: %d h shift, %d runs per mode\n", SHIFT_HOURS, RUNS);
+  printf("  %-8s %8s %8s %8s %8s %7s %7s\n", "mode", "ns/wake", "wake/h", "timers/h", "draw/h",
+         "writes", "bytes");
+  print_row("normal", &normal);
+  print_row("battery", &battery);
+  printf("  %-8s %8s %7.1fx %7.1fx %7.1fx %6.1fx %6.1fx\n", "saving", "",
+         ratio(normal.wakeups, battery.wakeups), ratio(normal.engine_timers, battery.engine_timers),
+         ratio(normal.redraws, battery.redraws), ratio(normal.writes, battery.writes),
+         ratio(normal.bytes, battery.bytes));
+  return 0;
+}
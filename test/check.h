@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+
+// Every failed check is reported with its line and the run carries on, so one run shows
+// everything that broke. A test's main returns check_result().
+
+static int check_failures = 0;
+
+#define CHECK(condition) \
+  ((condition) ? (void)0 : (check_failures++, \
+   (void)fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition)))
+
+#define CHECK_INT(actual, expected) do { \
+    long long check_actual = (actual); \
+    long long check_expected = (expected); \
+    if(check_actual != check_expected) { \
+      check_failures++; \
+      fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, \
+              check_actual, check_expected); \
+    } \
+  } while(0)
+
+#define CHECK_STR(actual, expected) do { \
+    const char* check_actual = (actual); \
+    const char* check_expected = (expected); \
+    if(strcmp(check_actual, check_expected) != 0) { \
+      check_failures++; \
+      fprintf(stderr, "%s:%d: %s is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, \
+              check_actual, check_expected); \
+    } \
+  } while(0)
+
+static inline int check_result(const char* name) {
+  if(check_failures > 0) {
+    fprintf(stderr, "%s: %d checks failed\n", name, check_failures);
+    return 1;
+  }
+  printf("%s: ok\n", name);
+  return 0;
+}
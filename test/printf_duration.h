@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdio.h>
+#include "duration.h"
+
+// The snprintf formatting duration_render replaced, extended the same way: a sign for
+// negative values, and an hours field in the minute-first formats from an hour up. The
+// equivalence test holds duration_render to it and the benchmark times the two against each
+// other.
+static inline int printf_duration(char* out, size_t size, int32_t seconds, DurationFormat format) {
+  const char* sign = seconds < 0 ? "-" : "";
+  uint32_t magnitude = seconds < 0 ? -(uint32_t)seconds : (uint32_t)seconds;
+  unsigned hours = magnitude / 3600;
+  unsigned minutes = magnitude / 60 % 60;
+  unsigned secs = magnitude % 60;
+  switch(format) {
+    case DURATION_H_MM_SS:
+      return snprintf(out, size, "%s%u:%02u:%02u", sign, hours, minutes, secs);
+    case DURATION_H_MM:
+      return snprintf(out, size, "%s%u:%02u", sign, hours, minutes);
+    case DURATION_MM_SS:
+      return hours > 0 ? snprintf(out, size, "%s%u:%02u:%02u", sign, hours, minutes, secs)
+                       : snprintf(out, size, "%s%02u:%02u", sign, minutes, secs);
+    case DURATION_MM:
+    default:
+      return hours > 0 ? snprintf(out, size, "%s%u:%02u", sign, hours, minutes)
+                       : snprintf(out, size, "%s%02u", sign, minutes);
+  }
+}
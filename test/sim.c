@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include "sim.h"
+#include "perf.h"
+
+#define SIM_DAY 1457308800LL
+
+int64_t sim_time(int hours, int minutes, int seconds) {
+  return (SIM_DAY + hours * 3600 + minutes * 60 + seconds) * 1000;
+}
+
+static void vibrate(Sim* sim, uint8_t notify) {
+  DutyVibe vibe = duty_vibe(notify);
+  if(vibe == DUTY_VIBE_NONE) {
+    return;
+  }
+  if(sim->vibe_count < SIM_VIBES) {
+    sim->vibes[sim->vibe_count++] = (SimVibe){ .at = epoch_ms(), .vibe = vibe };
+  }
+  sim->vibe_kinds[vibe]++;
+}
+
+// refresh_clocks and refresh_display, less the projections
+static void refresh(Sim* sim) {
+  vibrate(sim, duty_advance());
+  if(clock_view_render(&sim->view, epoch_ms()) != 0) {
+    sim->redraws++;
+    perf_count(PERF_REDRAW, 1);
+  }
+}
+
+// schedule_update, with the lateness of a busy watch added on
+static void schedule(Sim* sim) {
+  sim->update_at = -1;
+  int32_t wait = clock_view_next_update();
+  if(wait < 0) {
+    return;
+  }
+  int32_t late = sim->late_ms;
+  if(sim->jitter_ms > 0) {
+    sim->jitter_seed = sim->jitter_seed * 1103515245 + 12345;
+    late += (sim->jitter_seed >> 8) % sim->jitter_ms;
+  }
+  sim->update_at = epoch_ms() + wait + late;
+}
+
+// handle_timer rearms the update timer; handle_minute_tick leaves it be
+static void wake(Sim* sim, bool update_timer) {
+  perf_handler_begin();
+  sim->wakeups++;
+  refresh(sim);
+  if(update_timer) {
+    schedule(sim);
+  }
+  perf_handler_end();
+}
+
+void sim_start(Sim* sim, int64_t now, bool battery, bool domestic) {
+  memset(sim, 0, sizeof(*sim));
+  sim->update_at = -1;
+  host_reset();
+  host_set_time_ms(now);
+  perf_load();
+  perf_clear();
+  duty_init();
+  duty_apply_settings(battery, domestic, MOTION_OFF);
+  perf_set_mode(battery);
+  clock_view_init(&sim->view);
+  refresh(sim);
+  schedule(sim);
+}
+
+void sim_stop(Sim* sim) {
+  duty_deinit();
+  perf_save();
+}
+
+void sim_press(Sim* sim, DutyPress press) {
+  vibrate(sim, duty_press(press));
+  refresh(sim);
+  schedule(sim);
+}
+
+void sim_run_until(Sim* sim, int64_t until) {
+  for(;;) {
+    // Whichever comes first of the update timer, the minute tick and the engine's own timers
+    int64_t next = sim->update_at;
+    bool minute_ticks = clock_view_minute_ticks();
+    int64_t minute = (epoch_ms() / 60000 + 1) * 60000;
+    if(minute_ticks && (next < 0 || minute < next)) {
+      next = minute;
+    }
+    int64_t timer = host_next_timer();
+    if(timer >= 0 && (next < 0 || timer < next)) {
+      next = timer;
+    }
+    if(next < 0 || next > until) {
+      break;
+    }
+    host_set_time_ms(next);
+    if(next == timer) {
+      host_fire_timers();
+    } else {
+      wake(sim, next == sim->update_at);
+    }
+  }
+  host_set_time_ms(until);
+  host_fire_timers();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "duty.h"
+#include "clock_view.h"
+
+// Stands in for stopwatch.c on the host. The duty engine and the clock view are driven
+// through the same calls as the app makes, on the schedule the clock view asks for, and the
+// clock text and the vibrations are kept for checking rather than shown.
+
+#define SIM_VIBES 64
+
+typedef struct {
+  int64_t at;
+  DutyVibe vibe;
+} SimVibe;
+
+typedef struct {
+  ClockView view;
+  // When the update timer fires, or -1 while it is not armed
+  int64_t update_at;
+  // Added to every update timer, as a busy watch delivers them late; when jitter is set, a
+  // further 0 to jitter_ms - 1 chosen afresh each time
+  int32_t late_ms;
+  int32_t jitter_ms;
+  uint32_t jitter_seed;
+  // Every vibration in order, and how many of each kind
+  SimVibe vibes[SIM_VIBES];
+  uint8_t vibe_count;
+  uint32_t vibe_kinds[DUTY_VIBES];
+  // Wakeups of the update timer and minute tick, and passes that changed the text
+  uint32_t wakeups;
+  uint32_t redraws;
+} Sim;
+
+// A fresh install at now with the given settings, as if the app had just been opened
+void sim_start(Sim* sim, int64_t now, bool battery, bool domestic);
+// Close the app, writing out whatever is held back
+void sim_stop(Sim* sim);
+// A button press at the current time
+void sim_press(Sim* sim, DutyPress press);
+// Run every timer and minute tick that falls due up to until, then move the clock there
+void sim_run_until(Sim* sim, int64_t until);
+
+// Epoch milliseconds for a time of day on 2016-03-07, a Monday, in UTC
+int64_t sim_time(int hours, int minutes, int seconds);
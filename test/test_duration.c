@@ -0,0 +1,84 @@
+// Holds duration_render's in-place digit stepping to the snprintf formatting it replaced, on
+// every value a clock passes through counting up and down, in every format, and on random
+// runs of ticks, jumps and format changes. The returned flag must say whether the text moved.
+
+#include <stdlib.h>
+#include "check.h"
+#include "printf_duration.h"
+
+#define RANDOM_STEPS 1000000
+
+static const char* format_names[] = { "H:MM:SS", "H:MM", "MM:SS", "MM" };
+
+static uint32_t random_state = 1;
+
+static uint32_t next_random() {
+  random_state = random_state * 1103515245 + 12345;
+  return random_state >> 8;
+}
+
+// Render seconds and compare with the reference, reporting only the first mismatch per run
+static bool render_matches(DurationText* duration, int32_t seconds, DurationFormat format) {
+  char before[DURATION_TEXT_SIZE];
+  char expected[DURATION_TEXT_SIZE];
+  strcpy(before, duration->text);
+  bool changed = duration_render(duration, seconds, format);
+  printf_duration(expected, sizeof(expected), seconds, format);
+  if(strcmp(duration->text, expected) != 0 || duration->length != strlen(expected)
+      || changed != (strcmp(before, expected) != 0)) {
+    fprintf(stderr, "%s: %ld after \"%s\" rendered \"%s\" (changed %d), expected \"%s\"\n",
+            format_names[format], (long)seconds, before, duration->text, changed, expected);
+    check_failures++;
+    return false;
+  }
+  return true;
+}
+
+static void test_counting() {
+  for(DurationFormat format = DURATION_H_MM_SS; format <= DURATION_MM; format++) {
+    DurationText duration;
+    duration_init(&duration);
+    for(int32_t seconds = -4000; seconds <= 120000; seconds++) {
+      if(!render_matches(&duration, seconds, format)) {
+        break;
+      }
+    }
+    for(int32_t seconds = 120000; seconds >= -4000; seconds--) {
+      if(!render_matches(&duration, seconds, format)) {
+        break;
+      }
+    }
+  }
+}
+
+// Mostly ticks, as on the watch, with jumps of a few units, resumes from anywhere and the
+// odd change of format as battery saving comes and goes
+static void test_random_steps() {
+  DurationText duration;
+  duration_init(&duration);
+  int32_t seconds = 0;
+  DurationFormat format = DURATION_H_MM_SS;
+  for(uint32_t i = 0; i < RANDOM_STEPS; i++) {
+    uint32_t roll = next_random() % 100;
+    if(roll < 70) {
+      seconds += roll % 2 ? 1 : -1;
+    } else if(roll < 85) {
+      seconds += (int32_t)(next_random() % 241) - 120;
+    } else if(roll < 95) {
+      seconds = (int32_t)(next_random() % 400000) - 50000;
+    } else if(roll < 99) {
+      format = next_random() % 4;
+    } else {
+      seconds = next_random() % 2 ? INT32_MAX - (int32_t)(next_random() % 100) : 3600 * (int32_t)(next_random() % 100);
+    }
+    if(!render_matches(&duration, seconds, format)) {
+      return;
+    }
+  }
+}
+
+int main() {
+  test_counting();
+  test_random_steps();
+  return check_result("test_duration");
+}
@@ -0,0 +1,153 @@
+// Replays the accelerometer traces in test/traces through the motion detector, first on its
+// own and then through motion_feed and the duty engine as the app runs it. The detector should
+// take a minute or so to see driving and two to see a stop, sit through a wait at the lights,
+// and leave walking undecided. Suggest mode should raise each change once however long it is
+// ignored, and apply mode should press the buttons for the driver.
+
+#include <stdlib.h>
+#include "check.h"
+#include "sim.h"
+#include "motion_feed.h"
+
+#define TRACE_SAMPLES 8000
+#define TRACE_RATE 10
+
+typedef struct {
+  AccelData samples[TRACE_SAMPLES];
+  uint32_t count;
+} Trace;
+
+typedef struct {
+  uint32_t sample;
+  MotionState state;
+} Change;
+
+static void load_trace(Trace* trace, const char* name) {
+  char path[64];
+  snprintf(path, sizeof(path), "traces/%s.csv", name);
+  FILE* file = fopen(path, "r");
+  trace->count = 0;
+  if(file == NULL) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    check_failures++;
+    return;
+  }
+  char line[64];
+  int x, y, z;
+  while(fgets(line, sizeof(line), file) != NULL && trace->count < TRACE_SAMPLES) {
+    if(line[0] != '#' && sscanf(line, "%d,%d,%d", &x, &y, &z) == 3) {
+      trace->samples[trace->count++] = (AccelData){ .x = x, .y = y, .z = z };
+    }
+  }
+  fclose(file);
+}
+
+// Every change of state the detector reports, by the sample that completed its window
+static uint8_t classify_trace(const Trace* trace, Change* changes, uint8_t max_changes) {
+  Motion motion;
+  motion_init(&motion);
+  uint8_t count = 0;
+  for(uint32_t i = 0; i < trace->count; i++) {
+    const AccelData* sample = &trace->samples[i];
+    if(motion_add(&motion, sample->x, sample->y, sample->z) && count < max_changes) {
+      changes[count++] = (Change){ i + 1, motion.state };
+    }
+  }
+  return count;
+}
+
+static void test_drive_trace() {
+  static Trace trace;
+  load_trace(&trace, "drive");
+  Change changes[8];
+  uint8_t count = classify_trace(&trace, changes, ARRAY_LENGTH(changes));
+
+  // Driving from 120 s, 40 s at the lights from 300 s, and parked from 520 s
+  CHECK_INT(count, 2);
+  CHECK_INT(changes[0].state, MOTION_DRIVING);
+  CHECK(changes[0].sample >= (120 + 60) * TRACE_RATE && changes[0].sample <= (120 + 90) * TRACE_RATE);
+  CHECK_INT(changes[1].state, MOTION_STILL);
+  CHECK(changes[1].sample >= (520 + 120) * TRACE_RATE && changes[1].sample <= (520 + 150) * TRACE_RATE);
+}
+
+static void test_walk_trace() {
+  static Trace trace;
+  load_trace(&trace, "walk");
+  Change changes[8];
+  CHECK_INT(classify_trace(&trace, changes, ARRAY_LENGTH(changes)), 0);
+}
+
+static uint8_t notified[8];
+static uint8_t notified_count;
+
+static void record_notify(uint8_t notify) {
+  if(notified_count < ARRAY_LENGTH(notified)) {
+    notified[notified_count] = notify;
+  }
+  notified_count++;
+}
+
+// Feed a trace in real time from 06:00, the engine's timers running alongside
+static void feed_trace(Sim* sim, Trace* trace, uint8_t motion_mode) {
+  notified_count = 0;
+  sim_start(sim, sim_time(6, 0, 0), false, false);
+  duty_apply_settings(false, false, motion_mode);
+  motion_feed_update(record_notify);
+  // The service's batches, 2.5 s of samples each
+  const uint32_t batch = 25;
+  for(uint32_t i = 0; i < trace->count; i += batch) {
+    sim_run_until(sim, sim_time(6, 0, 0) + (int64_t)(i + batch) * 1000 / TRACE_RATE);
+    host_feed_accel(trace->samples + i, trace->count - i < batch ? trace->count - i : batch);
+  }
+  motion_feed_stop();
+}
+
+// Nobody answers the suggestion, so the detector should stay quiet for the rest of the drive
+// and say nothing more once it sees the cab parked, as that matches what was declared
+static void test_suggest_once() {
+  static Trace trace;
+  load_trace(&trace, "drive");
+  Sim sim;
+  feed_trace(&sim, &trace, MOTION_SUGGEST);
+  CHECK_INT(notified_count, 1);
+  CHECK_INT(notified[0], DUTY_NOTIFY_MOTION);
+  CHECK_INT(duty_vibe(notified[0]), DUTY_VIBE_LONG);
+  CHECK_INT(duty->activity, DUTY_OFF);
+  sim_stop(&sim);
+}
+
+static void test_apply() {
+  static Trace trace;
+  load_trace(&trace, "drive");
+  Sim sim;
+  feed_trace(&sim, &trace, MOTION_APPLY);
+  CHECK_INT(notified_count, 2);
+  CHECK(notified[0] & DUTY_NOTIFY_MOTION);
+  CHECK(notified[1] & DUTY_NOTIFY_MOTION);
+  CHECK_INT(duty->activity, DUTY_REST);
+  // Driving counted from when the detector saw it, 60 to 90 s in, to when it saw the stop
+  int64_t driven = clock_elapsed(&duty->drive, epoch_ms()) / 1000;
+  CHECK(driven >= 400 - 90 + 120 && driven <= 400 - 60 + 150);
+  sim_stop(&sim);
+}
+
+// Walking to the cab leaves an off-duty driver off duty
+static void test_apply_walk() {
+  static Trace trace;
+  load_trace(&trace, "walk");
+  Sim sim;
+  feed_trace(&sim, &trace, MOTION_APPLY);
+  CHECK_INT(notified_count, 0);
+  CHECK_INT(duty->activity, DUTY_OFF);
+  sim_stop(&sim);
+}
+
+int main() {
+  setenv("TZ", "UTC", 1);
+  test_drive_trace();
+  test_walk_trace();
+  test_suggest_once();
+  test_apply();
+  test_apply_walk();
+  return check_result("test_motion");
+}
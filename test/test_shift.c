@@ -0,0 +1,311 @@
+// Replays a 15-hour EU shift through the duty engine the way the app drives it, and checks
+// what the driver would see and feel and what ends up in flash: the clock text at points
+// through the day, every vibration and when it came, the checkpoint bytes and the duty log.
+// The same shift is run again with timers delivered late, since a deadline that is only
+// acted on at its exact second is missed by a watch that wakes a moment after it.
+
+#include <stdlib.h>
+#include "check.h"
+#include "sim.h"
+#include "duty_log.h"
+
+typedef enum {
+  STEP_PRESS,
+  STEP_TEXT,
+} StepKind;
+
+typedef struct {
+  int hours, minutes, seconds;
+  StepKind kind;
+  DutyPress press;
+  // Drive time, drive remaining, rest time and rest remaining, in normal and battery mode
+  const char* text[CLOCK_FIELDS];
+  const char* battery_text[CLOCK_FIELDS];
+} Step;
+
+// Work, then driving in 3h45 + 45 min with a 15 + 30 split break between, a full 45 minute
+// break, other work, two more hours behind the wheel and an hour of availability. The text
+// is sampled half a second after the time, clear of the update at the top of the second.
+static const Step shift[] = {
+  { 6, 0, 0, STEP_PRESS, DUTY_PRESS_WORK },
+  { 6, 15, 0, STEP_PRESS, DUTY_PRESS_DRIVE },
+  { 9, 45, 0, STEP_TEXT, 0, { "3:30:00", "1:00:00", "00:00", "45:00" }, { "3:30", "1:00", "00", "45" } },
+  { 10, 0, 0, STEP_PRESS, DUTY_PRESS_REST },
+  { 10, 10, 0, STEP_TEXT, 0, { "3:45:00", "0:45:00", "10:00", "35:00" }, { "3:45", "0:45", "10", "35" } },
+  { 10, 15, 0, STEP_PRESS, DUTY_PRESS_DRIVE },
+  { 11, 0, 0, STEP_PRESS, DUTY_PRESS_REST },
+  // The first 15 minutes still count, so 30 more complete the break
+  { 11, 20, 0, STEP_TEXT, 0, { "4:30:00", "0:00:00", "35:00", "10:00" }, { "4:30", "0:00", "35", "10" } },
+  { 11, 31, 0, STEP_TEXT, 0, { "0:00:00", "4:30:00", "00:00", "45:00" }, { "0:00", "4:30", "00", "45" } },
+  { 11, 35, 0, STEP_PRESS, DUTY_PRESS_DRIVE },
+  { 15, 30, 0, STEP_PRESS, DUTY_PRESS_REST },
+  { 16, 0, 0, STEP_TEXT, 0, { "3:55:00", "0:35:00", "30:00", "15:00" }, { "3:55", "0:35", "30", "15" } },
+  { 16, 30, 0, STEP_PRESS, DUTY_PRESS_WORK },
+  { 18, 0, 0, STEP_PRESS, DUTY_PRESS_DRIVE },
+  { 20, 0, 0, STEP_PRESS, DUTY_PRESS_WORK },
+  { 20, 0, 0, STEP_PRESS, DUTY_PRESS_WORK },
+  { 20, 59, 59, STEP_TEXT, 0, { "2:00:00", "2:30:00", "00:00", "45:00" }, { "2:00", "2:30", "00", "45" } },
+  { 21, 0, 0, STEP_PRESS, DUTY_PRESS_WORK },
+};
+
+typedef struct {
+  int hours, minutes, seconds;
+} Moment;
+
+// Drive warnings at 3h30, 4h and a second before 4h30 on the clock, and rest alerts a second
+// before each part of a break is done
+static const Moment alerts[] = {
+  { 9, 45, 0 },
+  { 10, 14, 59 },
+  { 10, 30, 0 },
+  { 10, 59, 59 },
+  { 11, 29, 59 },
+  { 15, 5, 0 },
+  { 15, 44, 59 },
+  { 16, 14, 59 },
+};
+
+typedef struct {
+  int hours, minutes, seconds;
+  DutyEvent event;
+} LoggedEvent;
+
+// Each completed break is logged as a reset exactly once
+static const LoggedEvent expected_log[] = {
+  { 6, 0, 0, DUTY_EVENT_WORK_START },
+  { 6, 15, 0, DUTY_EVENT_WORK_STOP },
+  { 6, 15, 0, DUTY_EVENT_DRIVE_START },
+  { 10, 0, 0, DUTY_EVENT_DRIVE_STOP },
+  { 10, 0, 0, DUTY_EVENT_REST_START },
+  { 10, 15, 0, DUTY_EVENT_REST_STOP },
+  { 10, 15, 0, DUTY_EVENT_DRIVE_START },
+  { 11, 0, 0, DUTY_EVENT_DRIVE_STOP },
+  { 11, 0, 0, DUTY_EVENT_REST_START },
+  { 11, 30, 1, DUTY_EVENT_REST_STOP },
+  { 11, 30, 1, DUTY_EVENT_BREAK_RESET },
+  { 11, 35, 0, DUTY_EVENT_DRIVE_START },
+  { 15, 30, 0, DUTY_EVENT_DRIVE_STOP },
+  { 15, 30, 0, DUTY_EVENT_REST_START },
+  { 16, 15, 1, DUTY_EVENT_REST_STOP },
+  { 16, 15, 1, DUTY_EVENT_BREAK_RESET },
+  { 16, 30, 0, DUTY_EVENT_WORK_START },
+  { 18, 0, 0, DUTY_EVENT_WORK_STOP },
+  { 18, 0, 0, DUTY_EVENT_DRIVE_START },
+  { 20, 0, 0, DUTY_EVENT_DRIVE_STOP },
+  { 20, 0, 0, DUTY_EVENT_WORK_START },
+  { 20, 0, 0, DUTY_EVENT_WORK_STOP },
+  { 20, 0, 0, DUTY_EVENT_AVAILABLE_START },
+  { 21, 0, 0, DUTY_EVENT_AVAILABLE_STOP },
+};
+
+static void run_shift(Sim* sim, bool battery, int32_t late_ms, int32_t jitter_ms) {
+  sim_start(sim, sim_time(5, 0, 0), battery, false);
+  sim->late_ms = late_ms;
+  sim->jitter_ms = jitter_ms;
+  sim->jitter_seed = 1;
+  for(size_t i = 0; i < ARRAY_LENGTH(shift); i++) {
+    const Step* step = &shift[i];
+    int64_t at = sim_time(step->hours, step->minutes, step->seconds);
+    if(step->kind == STEP_PRESS) {
+      sim_run_until(sim, at);
+      sim_press(sim, step->press);
+      continue;
+    }
+    // Late updates leave the text behind by up to the lateness, so it is only checked on time
+    if(late_ms > 0 || jitter_ms > 0) {
+      continue;
+    }
+    sim_run_until(sim, at + 500);
+    const char* const* text = battery ? step->battery_text : step->text;
+    for(uint8_t field = 0; field < CLOCK_FIELDS; field++) {
+      CHECK_STR(sim->view.text[field].text, text[field]);
+    }
+  }
+  sim_run_until(sim, sim_time(21, 0, 10));
+  sim_stop(sim);
+}
+
+// Every alert once, in order, no earlier than its second and no later than lateness allows
+static void check_vibes(const Sim* sim, int32_t latest_ms) {
+  CHECK_INT(sim->vibe_count, ARRAY_LENGTH(alerts));
+  CHECK_INT(sim->vibe_kinds[DUTY_VIBE_SHORT], ARRAY_LENGTH(alerts));
+  for(size_t i = 0; i < ARRAY_LENGTH(alerts) && i < sim->vibe_count; i++) {
+    int64_t due = sim_time(alerts[i].hours, alerts[i].minutes, alerts[i].seconds);
+    CHECK(sim->vibes[i].at >= due);
+    CHECK(sim->vibes[i].at <= due + latest_ms);
+  }
+}
+
+// Fletcher-16, written out again here so the check does not lean on duty.c's own
+static uint16_t fletcher16(const uint8_t* data, size_t length) {
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for(size_t i = 0; i < length; i++) {
+    sum1 = (sum1 + data[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+static uint32_t read_u32(const uint8_t* data) {
+  return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+// The newer of the two checkpoint keys holds a generation, the state as it is in memory and
+// a checksum over both
+static void check_checkpoint() {
+  uint8_t a[PERSIST_DATA_MAX_LENGTH];
+  uint8_t b[PERSIST_DATA_MAX_LENGTH];
+  const size_t size = 4 + sizeof(DutyState) + 2;
+  CHECK_INT(persist_get_size(PERSIST_STATE_A), size);
+  CHECK_INT(persist_get_size(PERSIST_STATE_B), size);
+  persist_read_data(PERSIST_STATE_A, a, sizeof(a));
+  persist_read_data(PERSIST_STATE_B, b, sizeof(b));
+  const uint8_t* newest = (int32_t)(read_u32(b) - read_u32(a)) > 0 ? b : a;
+  CHECK(memcmp(newest + 4, duty, sizeof(DutyState)) == 0);
+  uint16_t checksum = newest[size - 2] | newest[size - 1] << 8;
+  CHECK_INT(checksum, fletcher16(newest, size - 2));
+}
+
+// Walk every block from the oldest, decoding the varint deltas back into events
+static void check_log() {
+  uint8_t block[DUTY_LOG_BLOCK_SIZE];
+  uint32_t seq;
+  bool newest = false;
+  size_t found = 0;
+  for(uint32_t from = 0; !newest; from = seq + 1) {
+    size_t length = duty_log_read_from(from, block, &seq, &newest);
+    CHECK(length >= 13);
+    if(length < 13) {
+      return;
+    }
+    uint32_t when = read_u32(block + 4);
+    size_t at = 13;
+    while(at < length) {
+      uint32_t value = 0;
+      for(int shift = 0; at < length; shift += 7) {
+        uint8_t byte = block[at++];
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80)) {
+          break;
+        }
+      }
+      when += value >> 4;
+      if(found < ARRAY_LENGTH(expected_log)) {
+        const LoggedEvent* expected = &expected_log[found];
+        CHECK_INT(value & 0xf, expected->event);
+        CHECK_INT(when, sim_time(expected->hours, expected->minutes, expected->seconds) / 1000);
+      }
+      found++;
+    }
+  }
+  CHECK_INT(found, ARRAY_LENGTH(expected_log));
+}
+
+static void test_shift_on_time() {
+  Sim sim;
+  run_shift(&sim, false, 0, 0);
+  // The update lands 5 ms past each boundary
+  check_vibes(&sim, 10);
+  check_checkpoint();
+  check_log();
+}
+
+static void test_shift_battery() {
+  Sim sim;
+  run_shift(&sim, true, 0, 0);
+  check_vibes(&sim, 10);
+  check_checkpoint();
+  check_log();
+}
+
+// Timers that land anywhere up to a second late, so that the clock never reads exactly the
+// second of a deadline when it is checked, must still give every alert, and only once
+static void test_shift_late() {
+  Sim sim;
+  run_shift(&sim, false, 0, 990);
+  check_vibes(&sim, 1000);
+  Sim battery;
+  run_shift(&battery, true, 700, 0);
+  check_vibes(&battery, 710);
+}
+
+// A watch that sleeps through several deadlines gives one alert for all of them when it next
+// wakes, stops driving at the limit, and never repeats any of them afterwards
+static void test_skipped_ticks() {
+  Sim sim;
+  sim_start(&sim, sim_time(6, 0, 0), false, false);
+  duty_press(DUTY_PRESS_DRIVE);
+  host_set_time_ms(sim_time(11, 0, 0));
+  CHECK_INT(duty_vibe(duty_advance()), DUTY_VIBE_SHORT);
+  CHECK_INT(duty->activity, DUTY_OFF);
+  CHECK_INT(duty->drive_alarmed, duty_rules->drive_limit + 1);
+  // Stopped late, the clock keeps all that was driven and the remaining time stays at nothing
+  clock_view_render(&sim.view, epoch_ms());
+  CHECK_STR(sim.view.text[CLOCK_DRIVE_TIME].text, "5:00:00");
+  CHECK_STR(sim.view.text[CLOCK_DRIVE_REMAINING].text, "0:00:00");
+  for(int minute = 1; minute <= 60; minute++) {
+    host_set_time_ms(sim_time(11, minute, 0));
+    CHECK_INT(duty_advance(), 0);
+  }
+}
+
+// Crossing deadlines out of step with the clock: late, all at once and repeated
+static void test_cross_deadlines() {
+  DeadlineList list;
+  const RuleSet* rules = rules_get(RULES_EU_HGV);
+  rules_drive_deadlines(rules, &list);
+  int32_t handled = 0;
+  CHECK_INT(rules_cross_deadlines(&list, &handled, 12599), 0);
+  CHECK_INT(rules_cross_deadlines(&list, &handled, 12650), 1 << DEADLINE_ALERT);
+  CHECK_INT(handled, 12600);
+  CHECK_INT(rules_cross_deadlines(&list, &handled, 12650), 0);
+  CHECK_INT(rules_cross_deadlines(&list, &handled, 20000), 1 << DEADLINE_ALERT | 1 << DEADLINE_DRIVE_LIMIT);
+  CHECK_INT(handled, 16201);
+  CHECK_INT(rules_cross_deadlines(&list, &handled, 30000), 0);
+}
+
+// Nothing changes while a clock runs, so an hour of ticks must not arm a single timer
+static void test_idle_checkpoints() {
+  Sim sim;
+  sim_start(&sim, sim_time(6, 0, 0), false, false);
+  sim_press(&sim, DUTY_PRESS_DRIVE);
+  sim_run_until(&sim, sim_time(6, 1, 0));
+  uint32_t registered = host_timers_registered();
+  sim_run_until(&sim, sim_time(7, 1, 0));
+  CHECK_INT(host_timers_registered() - registered, 0);
+}
+
+// Handing over the wheel leaves the first driver available, not driving unwatched
+static void test_profile_handover() {
+  Sim sim;
+  sim_start(&sim, sim_time(6, 0, 0), false, false);
+  sim_press(&sim, DUTY_PRESS_DRIVE);
+  sim_run_until(&sim, sim_time(8, 0, 0));
+  duty_switch_profile(1);
+  CHECK_INT(duty_profile, 1);
+  duty_press(DUTY_PRESS_DRIVE);
+  host_set_time_ms(sim_time(12, 0, 0));
+  duty_switch_profile(0);
+  CHECK_INT(duty->activity, DUTY_AVAILABLE);
+  CHECK(!duty->drive.running);
+  CHECK_INT(clock_elapsed(&duty->drive, epoch_ms()) / 1000, 2 * 3600);
+  // The second driver handed back the same way
+  duty_switch_profile(1);
+  CHECK_INT(duty->activity, DUTY_AVAILABLE);
+  CHECK_INT(clock_elapsed(&duty->drive, epoch_ms()) / 1000, 4 * 3600);
+  sim_stop(&sim);
+  CHECK(duty_idle());
+}
+
+int main() {
+  setenv("TZ", "UTC", 1);
+  test_shift_on_time();
+  test_shift_battery();
+  test_shift_late();
+  test_skipped_ticks();
+  test_cross_deadlines();
+  test_idle_checkpoints();
+  test_profile_handover();
+  return check_result("test_shift");
+}
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# Writes the accelerometer traces test_motion replays, as x,y,z in milli-g at 10 Hz. They are
+# synthesised from a fixed seed rather than recorded, to stand for the motions the detector is
+# tuned on: a parked wrist barely moves, a cab shakes it by around a dozen milli-g on every
+# axis with a slow sway from corners and braking, and walking swings it by a third of a g at
+# each step. Run it from this directory after changing any of them.
+
+import math
+import random
+
+RATE = 10
+# A wrist on the wheel, roughly 1 g in all
+GRAVITY = (-180, 310, -930)
+
+
+def parked(rng, seconds):
+    return [tuple(g + round(rng.gauss(0, 2.5)) for g in GRAVITY) for _ in range(seconds * RATE)]
+
+
+def driving(rng, seconds):
+    samples = []
+    phase = rng.uniform(0, 2 * math.pi)
+    for i in range(seconds * RATE):
+        t = i / RATE
+        sway = 60 * math.sin(2 * math.pi * t / 8 + phase)
+        brake = 40 * math.sin(2 * math.pi * t / 23)
+        samples.append((GRAVITY[0] + round(sway + rng.gauss(0, 12)),
+                        GRAVITY[1] + round(brake + rng.gauss(0, 12)),
+                        GRAVITY[2] + round(rng.gauss(0, 12))))
+    return samples
+
+
+def walking(rng, seconds):
+    samples = []
+    for i in range(seconds * RATE):
+        t = i / RATE
+        step = 350 * math.sin(2 * math.pi * 1.8 * t)
+        swing = 250 * math.sin(2 * math.pi * 0.9 * t)
+        samples.append((GRAVITY[0] + round(swing + rng.gauss(0, 20)),
+                        GRAVITY[1] + round(rng.gauss(0, 20)),
+                        GRAVITY[2] + round(step + rng.gauss(0, 20))))
+    return samples
+
+
+def write(name, description, parts):
+    rng = random.Random(name)
+    with open(name + '.csv', 'w') as out:
+        out.write('# ' + description + '\n')
+        at = 0
+        for kind, seconds in parts:
+            out.write('# %d s: %s for %d s\n' % (at, kind.__name__, seconds))
+            at += seconds
+        for kind, seconds in parts:
+            for sample in kind(rng, seconds):
+                out.write('%d,%d,%d\n' % sample)
+
+
+write('drive', 'Park, drive, wait 40 s at lights, drive on and park again',
+      [(parked, 120), (driving, 180), (parked, 40), (driving, 180), (parked, 180)])
+write('walk', 'Stand, walk across the yard and stand again',
+      [(parked, 60), (walking, 300), (parked, 60)])
@@ -0,0 +1,559 @@
+// Replays recorded shifts through the watch's own duty engine and rule tables, and reports
+// every place where what the app would have done differs from what the record shows: breaks
+// it would or would not have counted, warnings it would have given, and limits it would have
+// enforced. The engine is compiled unchanged against host_sdk, with time moved forward from
+// one recorded event to the next and every deadline in between acted on as the worker would.
+//
+// Input is CSV, one activity change per line: driver,time,activity. Lines for each driver are
+// together and in time order. time is epoch seconds or ISO 8601 UTC (2016-03-01T06:30:00Z);
+// activity is drive, rest (or break), work, available (or poa) or off. A header line is
+// skipped. Files are read a line at a time, so memory use does not grow with their size, and
+// spread over one process per core.
+//
+// Output, on stdout, is one CSV line per difference: file,driver,time,check,app,record.
+// Totals and throughput go to stderr. Exits 1 if anything was flagged, 2 on errors.
+//
+// Usage: compliance [-d] [-j jobs] file...
+//   -d  domestic rules instead of EU HGV
+//   -j  worker processes, by default one per core
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "duty.h"
+
+// Clocks further apart than this at the start of driving are flagged
+#define CLOCK_TOLERANCE 60
+// A rest this long ends the shift
+#define DAILY_REST 32400
+// Past the deadline the engine acts on, as the worker's alarm is
+#define ALARM_SLACK_MS 5
+
+#define LINE_LENGTH 256
+#define DRIVER_LENGTH 32
+#define READ_BUFFER (64 * 1024)
+
+typedef struct {
+  uint64_t bytes;
+  uint64_t events;
+  uint64_t drivers;
+  uint64_t shifts;
+  uint64_t flags;
+  uint32_t files;
+  uint32_t errors;
+} Stats;
+
+// Shared with the workers, which each take the next file from next_file and keep their own
+// counts in stats
+typedef struct {
+  uint32_t next_file;
+  Stats stats[];
+} Shared;
+
+// What the rules say, worked out from the record alone
+typedef struct {
+  int32_t drive;
+  // Whether the first part of a split break has been taken since driving was reset
+  bool split_taken;
+  int32_t day_drive;
+  int32_t day_work;
+  int32_t week_drive;
+  int32_t last_week_drive;
+  int32_t week_work;
+  uint8_t week_extended_days;
+  int64_t week;
+  bool in_shift;
+} Reference;
+
+typedef struct {
+  const char* file;
+  char driver[DRIVER_LENGTH];
+  uint8_t activity;
+  time_t since;
+  Reference ref;
+  // Drive alerts the app gave during the current segment, and whether a clock difference was
+  // already flagged for it
+  uint8_t alerts;
+  bool clock_flagged;
+  Stats* stats;
+} Replay;
+
+static const char* activity_names[DUTY_ACTIVITIES] = {
+  [DUTY_OFF] = "off",
+  [DUTY_DRIVE] = "drive",
+  [DUTY_REST] = "rest",
+  [DUTY_OTHER_WORK] = "work",
+  [DUTY_AVAILABLE] = "available",
+};
+
+static const struct {
+  const char* name;
+  uint8_t activity;
+} activity_aliases[] = {
+  { "break", DUTY_REST },
+  { "poa", DUTY_AVAILABLE },
+};
+
+static bool domestic = false;
+static const RuleSet* rules;
+static int out_fd = STDOUT_FILENO;
+
+// Each flag goes out in a single write, well under PIPE_BUF, so the workers' lines never mix
+static void flag(Replay* replay, time_t at, const char* check, const char* app, const char* record) {
+  char when[32];
+  struct tm tm;
+  strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&at, &tm));
+  char line[LINE_LENGTH * 2];
+  int length = snprintf(line, sizeof(line), "%.200s,%s,%s,%s,%s,%s\n",
+                        replay->file, replay->driver, when, check, app, record);
+  if(length >= (int)sizeof(line)) {
+    length = sizeof(line) - 1;
+    line[length - 1] = '\n';
+  }
+  if(write(out_fd, line, length) < 0) {
+    replay->stats->errors++;
+  }
+  replay->stats->flags++;
+}
+
+static const char* duration(char* buffer, int32_t seconds) {
+  snprintf(buffer, 16, "%d:%02d:%02d", seconds / 3600, seconds / 60 % 60, seconds % 60);
+  return buffer;
+}
+
+static int64_t week_of(time_t t) {
+  // 1970-01-01 was a Thursday; weeks run Monday to Sunday like the app's totals
+  int64_t days = t >= 0 ? t / SECONDS_PER_DAY : (t - SECONDS_PER_DAY + 1) / SECONDS_PER_DAY;
+  int64_t shifted = days + 3;
+  return shifted >= 0 ? shifted / 7 : (shifted - 6) / 7;
+}
+
+static bool reference_over_limits(const Reference* ref, bool driving) {
+  if((rules->day_work_limit > 0 && ref->day_work >= rules->day_work_limit)
+      || (rules->week_work_limit > 0 && ref->week_work >= rules->week_work_limit)) {
+    return true;
+  }
+  if(!driving) {
+    return false;
+  }
+  return ref->day_drive >= rules_day_drive_limit(rules, ref->week_extended_days)
+      || (rules->week_drive_limit > 0 && ref->week_drive >= rules->week_drive_limit)
+      || (rules->fortnight_drive_limit > 0
+          && ref->week_drive + ref->last_week_drive >= rules->fortnight_drive_limit);
+}
+
+// Periods are counted in the week they end in
+static void reference_week(Reference* ref, time_t now) {
+  int64_t week = week_of(now);
+  if(week == ref->week) {
+    return;
+  }
+  ref->last_week_drive = week == ref->week + 1 ? ref->week_drive : 0;
+  ref->week_drive = 0;
+  ref->week_work = 0;
+  ref->week_extended_days = 0;
+  ref->week = week;
+}
+
+// Rest and time off duty both count as a break. A full break resets the drive clock, as does
+// the second part of a split break once the first has been taken.
+static void reference_rest(Reference* ref, int32_t seconds) {
+  if(seconds >= rules->break_total
+      || (rules->break_split > 0 && ref->split_taken && seconds >= rules->break_total - rules->break_split)) {
+    ref->drive = 0;
+    ref->split_taken = false;
+  } else if(rules->break_split > 0 && seconds >= rules->break_split) {
+    ref->split_taken = true;
+  }
+  if(seconds >= DAILY_REST && ref->in_shift) {
+    if(ref->day_drive > rules->day_drive_limit) {
+      ref->week_extended_days++;
+    }
+    ref->day_drive = 0;
+    ref->day_work = 0;
+    ref->in_shift = false;
+  }
+}
+
+// The same presses the driver would make, until the app is doing what the record says
+static uint8_t follow(uint8_t activity) {
+  uint8_t notify = 0;
+  for(int i = 0; i < DUTY_ACTIVITIES && duty->activity != activity; i++) {
+    DutyPress press = DUTY_PRESS_WORK;
+    if(activity == DUTY_DRIVE || activity == DUTY_REST) {
+      press = activity == DUTY_DRIVE ? DUTY_PRESS_DRIVE : DUTY_PRESS_REST;
+    } else if(activity == DUTY_OFF && (duty->activity == DUTY_DRIVE || duty->activity == DUTY_REST)) {
+      press = duty->activity == DUTY_DRIVE ? DUTY_PRESS_DRIVE : DUTY_PRESS_REST;
+    }
+    // Only the press that lands on the activity says anything about it
+    notify = duty_press(press);
+  }
+  return notify;
+}
+
+// Act on every deadline up to now, one at a time as the worker's alarm would
+static void run_until(Replay* replay, int64_t now) {
+  for(;;) {
+    int32_t wait = duty_next_change(0);
+    int64_t alarm = epoch_ms() + wait + ALARM_SLACK_MS;
+    if(wait < 0 || alarm > now) {
+      break;
+    }
+    host_set_time_ms(alarm);
+    host_fire_timers();
+    if(duty_advance() & DUTY_NOTIFY_ALERT && replay->activity == DUTY_DRIVE) {
+      replay->alerts++;
+    }
+  }
+  host_set_time_ms(now);
+  host_fire_timers();
+  if(duty_advance() & DUTY_NOTIFY_ALERT && replay->activity == DUTY_DRIVE) {
+    replay->alerts++;
+  }
+}
+
+static void start_driver(Replay* replay, const char* driver, time_t now) {
+  snprintf(replay->driver, sizeof(replay->driver), "%s", driver);
+  host_reset();
+  host_set_time_ms((int64_t)now * 1000);
+  duty_init();
+  duty_apply_settings(false, domestic, MOTION_OFF);
+  replay->activity = DUTY_OFF;
+  replay->since = now;
+  replay->ref = (Reference){ .week = week_of(now) };
+  replay->stats->drivers++;
+}
+
+static void end_segment(Replay* replay, time_t now) {
+  Reference* ref = &replay->ref;
+  int32_t seconds = now - replay->since;
+  char app[16], record[16];
+  reference_week(ref, now);
+  switch(replay->activity) {
+    case DUTY_DRIVE: {
+      int32_t before = ref->drive;
+      ref->drive += seconds;
+      ref->day_drive += seconds;
+      ref->week_drive += seconds;
+      ref->day_work += seconds;
+      ref->week_work += seconds;
+      uint8_t warnings = 0;
+      for(int i = 0; i < RULE_DRIVE_WARNINGS; i++) {
+        int32_t at = rules->drive_limit - rules->drive_warnings[i];
+        warnings += before < at && at <= ref->drive;
+      }
+      if(warnings != replay->alerts && !replay->clock_flagged) {
+        snprintf(app, sizeof(app), "%d", replay->alerts);
+        snprintf(record, sizeof(record), "%d", warnings);
+        flag(replay, now, "warnings", app, record);
+      }
+      if(before <= rules->drive_limit && ref->drive > rules->drive_limit) {
+        // Whether the app had already stopped driving at the limit
+        flag(replay, now, "drive_limit", duty->activity == DUTY_DRIVE ? "running" : "stopped",
+             duration(record, ref->drive));
+      }
+      break;
+    }
+    case DUTY_OFF:
+    case DUTY_REST:
+      reference_rest(ref, seconds);
+      break;
+    case DUTY_OTHER_WORK:
+      ref->day_work += seconds;
+      ref->week_work += seconds;
+      break;
+    default:
+      break;
+  }
+}
+
+static void start_segment(Replay* replay, uint8_t activity, time_t now) {
+  Reference* ref = &replay->ref;
+  char app[16], record[16];
+  replay->activity = activity;
+  replay->since = now;
+  replay->alerts = 0;
+  replay->clock_flagged = false;
+  uint8_t notify = follow(activity);
+  if(activity != DUTY_DRIVE && activity != DUTY_OTHER_WORK) {
+    return;
+  }
+  if(!ref->in_shift) {
+    ref->in_shift = true;
+    replay->stats->shifts++;
+  }
+
+  bool app_over = notify & DUTY_NOTIFY_OVER_LIMIT;
+  if(app_over != reference_over_limits(ref, activity == DUTY_DRIVE)) {
+    flag(replay, now, "day_limit", app_over ? "over" : "within", app_over ? "within" : "over");
+  }
+  if(activity != DUTY_DRIVE) {
+    return;
+  }
+
+  // The app's drive clock stops just past the limit, so compare no further than that
+  int32_t app_drive = clock_elapsed(&duty->drive, epoch_ms()) / 1000;
+  int32_t expected = ref->drive < rules->drive_limit + 1 ? ref->drive : rules->drive_limit + 1;
+  if(abs(app_drive - expected) <= CLOCK_TOLERANCE) {
+    return;
+  }
+  replay->clock_flagged = true;
+  if(app_drive == 0 || expected == 0) {
+    flag(replay, now, "break_reset", app_drive == 0 ? "reset" : "kept", expected == 0 ? "reset" : "kept");
+  } else {
+    flag(replay, now, "drive_clock", duration(app, app_drive), duration(record, expected));
+  }
+}
+
+static bool parse_time(const char* text, time_t* out) {
+  char* end;
+  long long seconds = strtoll(text, &end, 10);
+  if(end != text && *end == '\0') {
+    *out = seconds;
+    return true;
+  }
+  struct tm tm = {0};
+  char separator;
+  if(sscanf(text, "%4d-%2d-%2d%c%2d:%2d:%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &separator,
+            &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 7 || (separator != 'T' && separator != ' ')) {
+    return false;
+  }
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  *out = timegm(&tm);
+  return true;
+}
+
+static int parse_activity(const char* text) {
+  for(int i = 0; i < DUTY_ACTIVITIES; i++) {
+    if(strcasecmp(text, activity_names[i]) == 0) {
+      return i;
+    }
+  }
+  for(size_t i = 0; i < ARRAY_LENGTH(activity_aliases); i++) {
+    if(strcasecmp(text, activity_aliases[i].name) == 0) {
+      return activity_aliases[i].activity;
+    }
+  }
+  return -1;
+}
+
+// Split a line into its fields in place, trimming spaces and the line ending
+static int split(char* line, char** fields, int count) {
+  int found = 0;
+  char* field = line;
+  while(found < count) {
+    field += strspn(field, " ");
+    fields[found++] = field;
+    char* stop = field + strcspn(field, ",\r\n");
+    bool more = *stop == ',';
+    for(char* end = stop; end > field && end[-1] == ' '; end--) {
+      end[-1] = '\0';
+    }
+    *stop = '\0';
+    if(!more) {
+      break;
+    }
+    field = stop + 1;
+  }
+  return found;
+}
+
+static void check_file(const char* path, Stats* stats) {
+  static char buffer[READ_BUFFER];
+  FILE* file = fopen(path, "r");
+  if(file == NULL) {
+    fprintf(stderr, "compliance: %s: %s\n", path, strerror(errno));
+    stats->errors++;
+    return;
+  }
+  setvbuf(file, buffer, _IOFBF, sizeof(buffer));
+  stats->files++;
+
+  Replay replay = { .file = path, .stats = stats };
+  char line[LINE_LENGTH];
+  char bad[32];
+  uint64_t number = 0;
+  while(fgets(line, sizeof(line), file) != NULL) {
+    size_t length = strlen(line);
+    stats->bytes += length;
+    number++;
+    if(length == 0) {
+      // The line starts with a NUL byte, so nothing of it can be read
+      snprintf(bad, sizeof(bad), "line %llu", (unsigned long long)number);
+      flag(&replay, replay.since, "bad_input", "unreadable", bad);
+      continue;
+    }
+    if(line[length - 1] != '\n' && !feof(file)) {
+      // Far longer than any real line; skip the rest of it
+      int c;
+      while((c = fgetc(file)) != EOF && c != '\n') {
+        stats->bytes++;
+      }
+      snprintf(bad, sizeof(bad), "line %llu", (unsigned long long)number);
+      flag(&replay, replay.since, "bad_input", "too long", bad);
+      continue;
+    }
+
+    if(line[strspn(line, " \r\n")] == '\0') {
+      continue;
+    }
+    char* fields[3];
+    time_t now;
+    int activity = -1;
+    if(split(line, fields, 3) != 3 || !parse_time(fields[1], &now)
+        || (activity = parse_activity(fields[2])) < 0) {
+      // The first line may be a header
+      if(number > 1) {
+        snprintf(bad, sizeof(bad), "line %llu", (unsigned long long)number);
+        flag(&replay, replay.since, "bad_input", "unreadable", bad);
+      }
+      continue;
+    }
+    stats->events++;
+
+    if(replay.driver[0] == '\0' || strncmp(fields[0], replay.driver, sizeof(replay.driver) - 1) != 0) {
+      start_driver(&replay, fields[0], now);
+    } else if(now < replay.since) {
+      snprintf(bad, sizeof(bad), "line %llu", (unsigned long long)number);
+      flag(&replay, now, "bad_input", "out of order", bad);
+      continue;
+    }
+    if(activity == replay.activity) {
+      continue;
+    }
+    run_until(&replay, (int64_t)now * 1000);
+    end_segment(&replay, now);
+    start_segment(&replay, activity, now);
+  }
+  if(ferror(file)) {
+    fprintf(stderr, "compliance: %s: %s\n", path, strerror(errno));
+    stats->errors++;
+  }
+  fclose(file);
+}
+
+static void worker(Shared* shared, Stats* stats, char** files, uint32_t count) {
+  for(;;) {
+    uint32_t next = __atomic_fetch_add(&shared->next_file, 1, __ATOMIC_RELAXED);
+    if(next >= count) {
+      return;
+    }
+    check_file(files[next], stats);
+  }
+}
+
+static double seconds_since(const struct timespec* start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char** argv) {
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int option;
+  while((option = getopt(argc, argv, "dj:")) != -1) {
+    switch(option) {
+      case 'd':
+        domestic = true;
+        break;
+      case 'j':
+        jobs = strtol(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "usage: compliance [-d] [-j jobs] file...\n");
+        return 2;
+    }
+  }
+  char** files = argv + optind;
+  uint32_t count = argc - optind;
+  if(count == 0) {
+    fprintf(stderr, "usage: compliance [-d] [-j jobs] file...\n");
+    return 2;
+  }
+  if(jobs < 1) {
+    jobs = 1;
+  }
+  if(jobs > count) {
+    jobs = count;
+  }
+
+  // The app's day and week totals follow local time; records are in UTC
+  setenv("TZ", "UTC", 1);
+  tzset();
+  rules = rules_get(domestic ? RULES_DOMESTIC : RULES_EU_HGV);
+
+  Shared* shared = mmap(NULL, sizeof(Shared) + jobs * sizeof(Stats), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  int lines[2];
+  if(shared == MAP_FAILED || pipe(lines) != 0) {
+    perror("compliance");
+    return 2;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(long i = 0; i < jobs; i++) {
+    pid_t pid = fork();
+    if(pid < 0) {
+      perror("compliance: fork");
+      jobs = i;
+      break;
+    }
+    if(pid == 0) {
+      close(lines[0]);
+      out_fd = lines[1];
+      worker(shared, &shared->stats[i], files, count);
+      _exit(0);
+    }
+  }
+  close(lines[1]);
+
+  // Pass the workers' flags through until the last of them exits
+  char buffer[READ_BUFFER];
+  ssize_t length;
+  while((length = read(lines[0], buffer, sizeof(buffer))) != 0) {
+    if(length < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      perror("compliance");
+      break;
+    }
+    fwrite(buffer, 1, length, stdout);
+  }
+  fflush(stdout);
+
+  Stats total = {0};
+  bool failed = false;
+  for(long i = 0; i < jobs; i++) {
+    int status;
+    if(wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed = true;
+    }
+    const Stats* stats = &shared->stats[i];
+    total.bytes += stats->bytes;
+    total.events += stats->events;
+    total.drivers += stats->drivers;
+    total.shifts += stats->shifts;
+    total.flags += stats->flags;
+    total.files += stats->files;
+    total.errors += stats->errors;
+  }
+  double elapsed = seconds_since(&start);
+
+  fprintf(stderr, "%u files, %llu events, %llu drivers, %llu shifts, %llu flagged\n",
+          total.files, (unsigned long long)total.events, (unsigned long long)total.drivers,
+          (unsigned long long)total.shifts, (unsigned long long)total.flags);
+  fprintf(stderr, "%.3f s on %ld workers: %.1f MB/s, %.0f events/s, %.0f shifts/s\n",
+          elapsed, jobs, total.bytes / 1e6 / elapsed, total.events / elapsed, total.shifts / elapsed);
+
+  if(failed || total.errors > 0) {
+    return 2;
+  }
+  return total.flags > 0 ? 1 : 0;
+}
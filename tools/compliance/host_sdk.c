@@ -0,0 +1,188 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "host_sdk.h"
+
+// Enough keys for everything the duty engine persists
+#define HOST_KEYS 32
+// The engine never holds more than a couple of timers at once
+#define HOST_TIMERS 8
+
+typedef struct {
+  int16_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} StoredKey;
+
+struct AppTimer {
+  int64_t due;
+  AppTimerCallback callback;
+  void* data;
+};
+
+static StoredKey keys[HOST_KEYS];
+static int64_t now_ms = 0;
+static AppTimer timers[HOST_TIMERS];
+static uint32_t timers_registered = 0;
+static AccelDataHandler accel_handler = NULL;
+static uint32_t accel_batch = 0;
+
+void host_log(int level, const char* format, ...) {
+  static int enabled = -1;
+  if(enabled < 0) {
+    enabled = getenv("HOST_SDK_LOG") != NULL;
+  }
+  if(!enabled) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+// A free slot has no callback. With every slot taken the timer is refused, as the SDK does
+// when it runs out of memory.
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void* data) {
+  for(int i = 0; i < HOST_TIMERS; i++) {
+    if(timers[i].callback == NULL) {
+      timers[i] = (AppTimer){ .due = now_ms + timeout_ms, .callback = callback, .data = data };
+      timers_registered++;
+      return &timers[i];
+    }
+  }
+  return NULL;
+}
+
+void app_timer_cancel(AppTimer* timer) {
+  if(timer != NULL) {
+    timer->callback = NULL;
+  }
+}
+
+static AppTimer* earliest_timer() {
+  AppTimer* earliest = NULL;
+  for(int i = 0; i < HOST_TIMERS; i++) {
+    if(timers[i].callback != NULL && (earliest == NULL || timers[i].due < earliest->due)) {
+      earliest = &timers[i];
+    }
+  }
+  return earliest;
+}
+
+int64_t host_next_timer() {
+  AppTimer* timer = earliest_timer();
+  return timer != NULL ? timer->due : -1;
+}
+
+// The slot is freed before the callback runs, so the callback can register again
+void host_fire_timers() {
+  AppTimer* timer;
+  while((timer = earliest_timer()) != NULL && timer->due <= now_ms) {
+    AppTimerCallback callback = timer->callback;
+    timer->callback = NULL;
+    callback(timer->data);
+  }
+}
+
+uint32_t host_timers_registered() {
+  return timers_registered;
+}
+
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler) {
+  accel_handler = handler;
+  accel_batch = samples_per_update > 0 ? samples_per_update : 1;
+}
+
+void accel_data_service_unsubscribe() {
+  accel_handler = NULL;
+}
+
+int accel_service_set_sampling_rate(AccelSamplingRate rate) {
+  return S_SUCCESS;
+}
+
+bool host_feed_accel(AccelData* data, uint32_t count) {
+  // The handler may unsubscribe part way through
+  for(uint32_t i = 0; i < count && accel_handler != NULL; i += accel_batch) {
+    accel_handler(data + i, count - i < accel_batch ? count - i : accel_batch);
+  }
+  return accel_handler != NULL;
+}
+
+static StoredKey* stored(uint32_t key) {
+  return key < HOST_KEYS && keys[key].size > 0 ? &keys[key] : NULL;
+}
+
+bool persist_exists(const uint32_t key) {
+  return stored(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+  StoredKey* entry = stored(key);
+  return entry != NULL ? entry->size : E_DOES_NOT_EXIST;
+}
+
+int persist_read_data(const uint32_t key, void* buffer, const size_t buffer_size) {
+  StoredKey* entry = stored(key);
+  if(entry == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+  size_t size = (size_t)entry->size < buffer_size ? (size_t)entry->size : buffer_size;
+  memcpy(buffer, entry->data, size);
+  return size;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+  int32_t value = 0;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+status_t persist_write_data(const uint32_t key, const void* data, const size_t size) {
+  if(key >= HOST_KEYS || size == 0 || size > PERSIST_DATA_MAX_LENGTH) {
+    return E_RANGE;
+  }
+  memcpy(keys[key].data, data, size);
+  keys[key].size = size;
+  return size;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+status_t persist_delete(const uint32_t key) {
+  if(stored(key) == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+  keys[key].size = 0;
+  return S_SUCCESS;
+}
+
+uint16_t time_ms(time_t* t_utc, uint16_t* out_ms) {
+  uint16_t milliseconds = now_ms % 1000;
+  if(t_utc != NULL) {
+    *t_utc = now_ms / 1000;
+  }
+  if(out_ms != NULL) {
+    *out_ms = milliseconds;
+  }
+  return milliseconds;
+}
+
+time_t host_time(time_t* t) {
+  time_t seconds = now_ms / 1000;
+  if(t != NULL) {
+    *t = seconds;
+  }
+  return seconds;
+}
+
+void host_set_time_ms(int64_t now) {
+  now_ms = now;
+}
+
+void host_reset() {
+  memset(keys, 0, sizeof(keys));
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// Just enough of the Pebble SDK for the duty engine to run on a host. Persistent storage is
+// an in-memory table, the time is whatever the caller last set, and timers only fire when
+// the caller moves time past them and calls host_fire_timers.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+typedef int32_t status_t;
+#define S_SUCCESS 0
+#define E_DOES_NOT_EXIST -5
+#define E_RANGE -6
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define SECONDS_PER_DAY 86400
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+};
+// Written to stderr only when HOST_SDK_LOG is set in the environment
+#define APP_LOG(level, ...) host_log(level, __VA_ARGS__)
+void host_log(int level, const char* format, ...);
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void* data);
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void* data);
+void app_timer_cancel(AppTimer* timer);
+
+typedef enum {
+  ACCEL_SAMPLING_10HZ = 10,
+  ACCEL_SAMPLING_25HZ = 25,
+} AccelSamplingRate;
+typedef struct {
+  int16_t x;
+  int16_t y;
+  int16_t z;
+  bool did_vibrate;
+  uint64_t timestamp;
+} AccelData;
+typedef void (*AccelDataHandler)(AccelData* data, uint32_t num_samples);
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler);
+void accel_data_service_unsubscribe();
+int accel_service_set_sampling_rate(AccelSamplingRate rate);
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+int persist_read_data(const uint32_t key, void* buffer, const size_t buffer_size);
+int32_t persist_read_int(const uint32_t key);
+status_t persist_write_data(const uint32_t key, const void* data, const size_t size);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+status_t persist_delete(const uint32_t key);
+
+uint16_t time_ms(time_t* t_utc, uint16_t* out_ms);
+time_t host_time(time_t* t);
+#define time(t) host_time(t)
+
+// Set the clock the engine sees, in epoch milliseconds
+void host_set_time_ms(int64_t now);
+// Forget everything persisted, as on a fresh install. Pending timers are left alone, as the
+// engine still holds them.
+void host_reset();
+
+// When the earliest pending timer is due in epoch milliseconds, or -1 if none is
+int64_t host_next_timer();
+// Run every timer due by the current time, earliest first
+void host_fire_timers();
+// Timers registered since the start, for counting wakeups
+uint32_t host_timers_registered();
+
+// Hand samples to the accelerometer subscriber in batches of the size it asked for, as if
+// they had just been taken. Returns false if nothing is subscribed.
+bool host_feed_accel(AccelData* data, uint32_t count);
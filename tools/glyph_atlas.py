@@ -0,0 +1,311 @@
+#!/usr/bin/env python
+#
+# Renders the glyphs the timers need from a TrueType font into one packed 1-bit atlas, so the
+# watch blits digits instead of running them through the font engine. Needs nothing beyond
+# the standard library, so it runs wherever the wscript does.
+#
+# Output, little-endian, matching AtlasHeader in src/glyph_atlas.h:
+#   char chars[GLYPHS]
+#   per size: uint8 top, uint8 height, uint8 advance[GLYPHS], uint16 x[GLYPHS], uint16 y
+#   the atlas as a version 1, 1-bit .pbi image
+#
+# Usage: glyph_atlas.py font.ttf out.bin size [size ...]
+
+import math
+import struct
+import sys
+
+CHARS = '0123456789:-'
+
+# Samples per pixel along each axis; a pixel is set when at least half of them are inside
+SUPERSAMPLE = 4
+# Line segments per quadratic curve
+CURVE_STEPS = 8
+
+
+class Font(object):
+    def __init__(self, data):
+        self.data = data
+        self.tables = {}
+        count = struct.unpack_from('>H', data, 4)[0]
+        for i in range(count):
+            tag, _, offset, length = struct.unpack_from('>4sIII', data, 12 + i * 16)
+            self.tables[tag.decode('ascii')] = (offset, length)
+
+        head = self.tables['head'][0]
+        self.units_per_em = struct.unpack_from('>H', data, head + 18)[0]
+        self.long_loca = struct.unpack_from('>h', data, head + 50)[0] == 1
+        hhea = self.tables['hhea'][0]
+        self.ascender = struct.unpack_from('>h', data, hhea + 4)[0]
+        self.metrics_count = struct.unpack_from('>H', data, hhea + 34)[0]
+        self.cmap = self._read_cmap()
+
+    def _read_cmap(self):
+        cmap = self.tables['cmap'][0]
+        count = struct.unpack_from('>H', self.data, cmap + 2)[0]
+        for i in range(count):
+            platform, encoding, offset = struct.unpack_from('>HHI', self.data, cmap + 4 + i * 8)
+            table = cmap + offset
+            if struct.unpack_from('>H', self.data, table)[0] == 4 and (platform, encoding) in ((3, 1), (0, 3), (0, 4)):
+                return self._read_cmap4(table)
+        raise ValueError('font has no Unicode BMP cmap')
+
+    def _read_cmap4(self, table):
+        segments = struct.unpack_from('>H', self.data, table + 6)[0] // 2
+        ends = table + 14
+        starts = ends + segments * 2 + 2
+        deltas = starts + segments * 2
+        ranges = deltas + segments * 2
+        mapping = {}
+        for s in range(segments):
+            end = struct.unpack_from('>H', self.data, ends + s * 2)[0]
+            start = struct.unpack_from('>H', self.data, starts + s * 2)[0]
+            delta = struct.unpack_from('>h', self.data, deltas + s * 2)[0]
+            range_offset = struct.unpack_from('>H', self.data, ranges + s * 2)[0]
+            for code in range(start, min(end, 0xfffe) + 1):
+                if range_offset == 0:
+                    glyph = (code + delta) & 0xffff
+                else:
+                    at = ranges + s * 2 + range_offset + (code - start) * 2
+                    glyph = struct.unpack_from('>H', self.data, at)[0]
+                    if glyph != 0:
+                        glyph = (glyph + delta) & 0xffff
+                mapping[code] = glyph
+        return mapping
+
+    def glyph_index(self, char):
+        return self.cmap.get(ord(char), 0)
+
+    def advance(self, glyph):
+        hmtx = self.tables['hmtx'][0]
+        return struct.unpack_from('>H', self.data, hmtx + min(glyph, self.metrics_count - 1) * 4)[0]
+
+    def _glyph_offset(self, glyph):
+        loca = self.tables['loca'][0]
+        if self.long_loca:
+            start, end = struct.unpack_from('>II', self.data, loca + glyph * 4)
+        else:
+            start, end = [v * 2 for v in struct.unpack_from('>HH', self.data, loca + glyph * 2)]
+        return self.tables['glyf'][0] + start, end - start
+
+    def contours(self, glyph):
+        """The glyph's outline as lists of (x, y, on_curve) points in font units"""
+        offset, length = self._glyph_offset(glyph)
+        if length == 0:
+            return []
+        count = struct.unpack_from('>h', self.data, offset)[0]
+        if count < 0:
+            return self._composite(offset)
+        return self._simple(offset, count)
+
+    def _simple(self, offset, count):
+        data = self.data
+        ends = struct.unpack_from('>%dH' % count, data, offset + 10)
+        points = ends[-1] + 1 if count else 0
+        at = offset + 10 + count * 2
+        at += 2 + struct.unpack_from('>H', data, at)[0]
+
+        flags = []
+        while len(flags) < points:
+            flag = data[at] if isinstance(data[at], int) else ord(data[at])
+            at += 1
+            flags.append(flag)
+            if flag & 8:
+                repeat = data[at] if isinstance(data[at], int) else ord(data[at])
+                at += 1
+                flags.extend([flag] * repeat)
+
+        def coordinates(short_bit, same_bit):
+            values = []
+            value = 0
+            position = at
+            for flag in flags[:points]:
+                if flag & short_bit:
+                    delta = struct.unpack_from('>B', data, position)[0]
+                    position += 1
+                    value += delta if flag & same_bit else -delta
+                elif not flag & same_bit:
+                    value += struct.unpack_from('>h', data, position)[0]
+                    position += 2
+                values.append(value)
+            return values, position
+
+        xs, at = coordinates(2, 16)
+        ys, at = coordinates(4, 32)
+        contours = []
+        first = 0
+        for end in ends:
+            contours.append([(xs[i], ys[i], bool(flags[i] & 1)) for i in range(first, end + 1)])
+            first = end + 1
+        return contours
+
+    def _composite(self, offset):
+        contours = []
+        at = offset + 10
+        while True:
+            flags, glyph = struct.unpack_from('>HH', self.data, at)
+            at += 4
+            if flags & 1:
+                dx, dy = struct.unpack_from('>hh', self.data, at)
+                at += 4
+            else:
+                dx, dy = struct.unpack_from('>bb', self.data, at)
+                at += 2
+            # Only translated components; the timer glyphs need nothing more
+            if flags & 8:
+                at += 2
+            elif flags & 0x40:
+                at += 4
+            elif flags & 0x80:
+                at += 8
+            for contour in self.contours(glyph):
+                contours.append([(x + dx, y + dy, on) for x, y, on in contour])
+            if not flags & 0x20:
+                return contours
+
+
+def flatten(contour, scale):
+    """Turn a TrueType contour into a closed polygon in pixels, y growing downwards"""
+    points = list(contour)
+    # Start on an on-curve point, adding the implied one if there are none
+    for i, point in enumerate(points):
+        if point[2]:
+            points = points[i:] + points[:i]
+            break
+    else:
+        a, b = points[0], points[1]
+        points.insert(0, ((a[0] + b[0]) / 2.0, (a[1] + b[1]) / 2.0, True))
+
+    polygon = []
+    previous = points[0]
+    control = None
+    for point in points[1:] + points[:1]:
+        if point[2]:
+            if control is None:
+                polygon.append(point)
+            else:
+                polygon.extend(curve(previous, control, point))
+                control = None
+            previous = point
+        elif control is None:
+            control = point
+        else:
+            middle = ((control[0] + point[0]) / 2.0, (control[1] + point[1]) / 2.0, True)
+            polygon.extend(curve(previous, control, middle))
+            previous = middle
+            control = point
+    return [(x * scale, -y * scale) for x, y, _ in polygon]
+
+
+def curve(start, control, end):
+    steps = []
+    for i in range(1, CURVE_STEPS + 1):
+        t = float(i) / CURVE_STEPS
+        u = 1 - t
+        steps.append((u * u * start[0] + 2 * u * t * control[0] + t * t * end[0],
+                      u * u * start[1] + 2 * u * t * control[1] + t * t * end[1], True))
+    return steps
+
+
+def rasterise(polygons, width, top, height):
+    """Nonzero-winding fill of polygons, whose y is relative to the baseline, into rows of
+    pixels covering y from top to top + height"""
+    coverage = [[0] * width for _ in range(height)]
+    edges = []
+    for polygon in polygons:
+        for i in range(len(polygon)):
+            (x0, y0), (x1, y1) = polygon[i - 1], polygon[i]
+            if y0 != y1:
+                edges.append((x0, y0, x1, y1))
+
+    for sample_row in range(height * SUPERSAMPLE):
+        y = top + (sample_row + 0.5) / SUPERSAMPLE
+        crossings = []
+        for x0, y0, x1, y1 in edges:
+            if (y0 <= y < y1) or (y1 <= y < y0):
+                x = x0 + (y - y0) * (x1 - x0) / (y1 - y0)
+                crossings.append((x, 1 if y1 > y0 else -1))
+        crossings.sort()
+        winding = 0
+        row = coverage[sample_row // SUPERSAMPLE]
+        for i, (x, direction) in enumerate(crossings):
+            winding += direction
+            if winding == 0 or i + 1 == len(crossings):
+                continue
+            start, end = x, crossings[i + 1][0]
+            for sample in range(width * SUPERSAMPLE):
+                sx = (sample + 0.5) / SUPERSAMPLE
+                if start <= sx < end:
+                    row[sample // SUPERSAMPLE] += 1
+
+    threshold = SUPERSAMPLE * SUPERSAMPLE // 2
+    return [[value >= threshold for value in row] for row in coverage]
+
+
+def render_size(font, size):
+    """Cells for every glyph at size pixels per em, cropped to the rows any of them touch"""
+    scale = float(size) / font.units_per_em
+    glyphs = [font.glyph_index(c) for c in CHARS]
+    digit_advance = max(font.advance(g) for g, c in zip(glyphs, CHARS) if c.isdigit())
+    advances = []
+    outlines = []
+    for glyph, char in zip(glyphs, CHARS):
+        # Digits share one advance so the clocks never shift as they tick
+        advance = digit_advance if char.isdigit() else font.advance(glyph)
+        advances.append(int(round(advance * scale)))
+        outlines.append([flatten(c, scale) for c in font.contours(glyph)])
+
+    ys = [y for polygons in outlines for polygon in polygons for _, y in polygon]
+    ink_top = int(math.floor(min(ys)))
+    height = int(math.ceil(max(ys))) - ink_top
+    cells = [rasterise(polygons, advance, ink_top, height) for polygons, advance in zip(outlines, advances)]
+    # Rows from the top of the line box, where text drawn by the font engine started
+    top = int(round(font.ascender * scale)) + ink_top
+    return top, height, advances, cells
+
+
+def pbi(rows, width):
+    """A version 1, 1-bit GBitmap, white for set pixels"""
+    row_size = (width + 31) // 32 * 4
+    out = bytearray(struct.pack('<HHhhhh', row_size, 1 << 12, 0, 0, width, len(rows)))
+    for row in rows:
+        packed = bytearray(row_size)
+        for x, on in enumerate(row):
+            if on:
+                packed[x // 8] |= 1 << (x % 8)
+        out += packed
+    return out
+
+
+def build(font_path, out_path, sizes):
+    with open(font_path, 'rb') as f:
+        font = Font(f.read())
+
+    rendered = [render_size(font, size) for size in sizes]
+    width = max(sum(advances) for _, _, advances, _ in rendered)
+    rows = []
+    header = bytearray(CHARS.encode('ascii'))
+    for top, height, advances, cells in rendered:
+        y = len(rows)
+        xs = []
+        block = [[False] * width for _ in range(height)]
+        x = 0
+        for advance, cell in zip(advances, cells):
+            xs.append(x)
+            for r in range(height):
+                block[r][x:x + advance] = cell[r]
+            x += advance
+        rows.extend(block)
+        header += struct.pack('<BB', top, height)
+        header += struct.pack('<%dB' % len(CHARS), *advances)
+        header += struct.pack('<%dH' % len(CHARS), *xs)
+        header += struct.pack('<H', y)
+
+    with open(out_path, 'wb') as f:
+        f.write(header + pbi(rows, width))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 4:
+        sys.exit('usage: glyph_atlas.py font.ttf out.bin size [size ...]')
+    build(sys.argv[1], sys.argv[2], [int(s) for s in sys.argv[3:]])
@@ -0,0 +1,107 @@
+/*
+ * Driver Timer background worker.
+ *
+ * Owns the duty state while it runs, so the clocks and alerts carry on with the app closed.
+ * The app forwards button presses and settings here and reloads the checkpoint whenever we
+ * report a change, stopping us once nothing is left to watch so the system's one background
+ * worker slot is free again. Workers cannot vibrate, so an alert relaunches the app to do it.
+ */
+
+#include <pebble_worker.h>
+#include "../src/duty/duty.h"
+#include "../src/duty/duty_log.h"
+#include "../src/duty/motion_feed.h"
+#include "../src/duty/perf.h"
+
+// One-shot timer for the next deadline of a running clock; nothing else wakes us
+static AppTimer* alarm_timer = NULL;
+
+static void handle_alarm(void* data);
+
+static void schedule_alarm() {
+  if(alarm_timer != NULL) {
+    app_timer_cancel(alarm_timer);
+    alarm_timer = NULL;
+  }
+  int32_t wait = duty_next_change(0);
+  if(wait < 0) {
+    return;
+  }
+  // Land just past the boundary so the whole-second checks see the new value
+  alarm_timer = app_timer_register(wait + 5, handle_alarm, NULL);
+}
+
+// Save straight away so the app reads the change, tell it, and rearm. Once idle the app
+// takes the state back and stops us, so the log goes down too rather than waiting.
+static void publish(uint8_t notify) {
+  duty_save();
+  if(duty_idle()) {
+    duty_log_flush();
+  }
+  AppWorkerMessage message = { .data0 = notify };
+  app_worker_send_message(DUTY_MSG_CHANGED, &message);
+  if(notify & (DUTY_NOTIFY_ALERT | DUTY_NOTIFY_MOTION)) {
+    // The message above is lost if the app is closed, so the app reads why it was opened
+    // from flash instead
+    status_t status = persist_write_int(PERSIST_LAUNCH_NOTIFY, notify);
+    perf_persist_written(status, sizeof(int32_t));
+    worker_launch_app();
+  }
+  schedule_alarm();
+  motion_feed_update(publish);
+}
+
+static void handle_alarm(void* data) {
+  perf_handler_begin();
+  alarm_timer = NULL;
+  publish(duty_advance());
+  perf_handler_end();
+}
+
+static void handle_app_message(uint16_t type, AppWorkerMessage* message) {
+  uint8_t notify = 0;
+  switch(type) {
+    case DUTY_MSG_PRESS:
+      if(message->data0 >= DUTY_PRESSES) {
+        return;
+      }
+      notify = duty_press(message->data0);
+      break;
+    case DUTY_MSG_RESET:
+      duty_reset();
+      break;
+    case DUTY_MSG_SETTINGS:
+      duty_apply_settings(message->data0, message->data1, message->data2);
+      perf_set_mode(duty->battery_setting);
+      break;
+    case DUTY_MSG_SWITCH_PROFILE:
+      notify = duty_switch_profile(message->data0);
+      break;
+    default:
+      return;
+  }
+  publish(notify | duty_advance());
+}
+
+static void handle_init() {
+  perf_load();
+  duty_init();
+  perf_set_mode(duty->battery_setting);
+  app_worker_message_subscribe(handle_app_message);
+  // Anything that passed while nobody was watching is alerted now
+  publish(duty_advance());
+}
+
+static void handle_deinit() {
+  motion_feed_stop();
+  app_worker_message_unsubscribe();
+  duty_deinit();
+  perf_save();
+}
+
+int main() {
+  handle_init();
+  worker_event_loop();
+  handle_deinit();
+  return 0;
+}